@@ -1,16 +1,65 @@
 #version 330 core 
 in vec3 fragNor;
 in vec3 fragPos;
+in float fragAO;
 out vec4 color;
 
+layout(std140) uniform Camera
+{
+	mat4 P;
+	mat4 V;
+	mat4 PV;
+	vec4 viewport;
+	vec4 time;
+};
+// clustered point lights (LightClusters)
+layout(std140) uniform Lights
+{
+	ivec4 lightGrid; // clusters in x, y, z, lights this frame
+	vec4 lightSlices; // slice = log(view depth) * x + y
+	ivec4 lightBase; // first texel of the lights, grid and index lists
+};
+uniform samplerBuffer clusterLights; // position and radius, color
+uniform usamplerBuffer clusterGrid; // offset and count of each cluster's index list
+uniform usamplerBuffer clusterIndices;
+
 vec3 lightPos = vec3(-100,-100,-100);
 
+// diffuse light of the point lights in this fragment's cluster
+vec3 pointLights(vec3 pos, vec3 normal)
+{
+	if (lightGrid.w == 0)
+	{
+		return vec3(0);
+	}
+	float depth = -(V * vec4(pos, 1)).z;
+	ivec3 cell = ivec3(ivec2((gl_FragCoord.xy - viewport.xy) / viewport.zw * vec2(lightGrid.xy)),
+		int(floor(log(max(depth, 1e-6)) * lightSlices.x + lightSlices.y)));
+	cell = clamp(cell, ivec3(0), lightGrid.xyz - 1);
+	uvec2 range = texelFetch(clusterGrid, lightBase.y + (cell.z * lightGrid.y + cell.y) * lightGrid.x + cell.x).xy;
+
+	vec3 sum = vec3(0);
+	for (uint i = 0u; i < range.y; i++)
+	{
+		int light = lightBase.x + 2 * int(texelFetch(clusterIndices, lightBase.z + int(range.x + i)).x);
+		vec4 posRadius = texelFetch(clusterLights, light);
+		vec3 toLight = posRadius.xyz - pos;
+		float dist2 = max(dot(toLight, toLight), 1e-8);
+		// inverse square, faded to 0 at the radius
+		float fade = clamp(1.0 - dist2 * dist2 / pow(posRadius.w, 4.0), 0.0, 1.0);
+		float diffuse = max(dot(normal, toLight * inversesqrt(dist2)), 0.0);
+		sum += texelFetch(clusterLights, light + 1).rgb * diffuse * fade * fade / (dist2 + 1.0);
+	}
+	return sum;
+}
+
 void main()
 {
 	vec3 lightDir = normalize(lightPos - fragPos);
 	vec3 normal = normalize(fragNor);
 	float diffuse =  pow(dot(normal, lightDir), 2);
 	vec3 basecolor = vec3(1,0.77,0.6);
-	color = vec4(diffuse * basecolor, 1);
+	// a little ambient, so the occlusion shows in the shadowed parts too
+	color = vec4((0.2 + diffuse + pointLights(fragPos, normal)) * fragAO * basecolor, 1);
 	//color = vec4(normal, 1);
 }
@@ -0,0 +1,14 @@
+#version 330 core 
+in vec3 fragNor;
+layout(location = 0) out vec4 color;
+// local space normal, and depth (linear, the bake is orthographic)
+layout(location = 1) out vec4 normalDepth;
+
+uniform vec3 baseColor;
+
+void main()
+{
+	vec3 normal = normalize(fragNor);
+	color = vec4(baseColor, 1);
+	normalDepth = vec4(normal * 0.5 + 0.5, gl_FragCoord.z);
+}
@@ -0,0 +1,28 @@
+#version  330 core
+layout(location = 0) in vec4 vertPos;
+layout(location = 1) in vec3 vertNor;
+layout(location = 2) in vec2 vertTex;
+// mesh decode constants (Shape::init): position = bias + vertPos * scale,
+// scale.w = 1 when vertNor holds an octahedral normal in xy
+layout(location = 3) in vec4 vertDecodeBias;
+layout(location = 4) in vec4 vertDecodeScale;
+// orthographic view of one atlas cell (Impostor::bake)
+uniform mat4 bakeMVP;
+out vec3 fragNor;
+
+vec3 octDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+	{
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(n);
+}
+
+void main()
+{
+	vec4 pos = vec4(vertDecodeBias.xyz + vertPos.xyz * vertDecodeScale.xyz, 1.0);
+	fragNor = vertDecodeScale.w > 0.5 ? octDecode(vertNor.xy) : vertNor;
+	gl_Position = bakeMVP * pos;
+}
@@ -0,0 +1,38 @@
+#version 330 core 
+in vec2 fragTex;
+in vec3 fragPos;
+in vec3 fragDir;
+in float fragRadius;
+out vec4 color;
+layout(std140) uniform Camera
+{
+	mat4 P;
+	mat4 V;
+	mat4 PV;
+	vec4 viewport;
+	vec4 time;
+};
+uniform sampler2D impostorColor;
+uniform sampler2D impostorNormal;
+
+vec3 lightPos = vec3(-100,-100,-100);
+
+void main()
+{
+	vec4 albedo = texture(impostorColor, fragTex);
+	if (albedo.a < 0.5)
+	{
+		discard;
+	}
+	vec4 normalDepth = texture(impostorNormal, fragTex);
+
+	// baked depth is 0.5 at the center of the bounding sphere, 0 and 1 on it
+	vec3 pos = fragPos - fragDir * (normalDepth.w * 2.0 - 1.0) * fragRadius;
+	vec4 clip = PV * vec4(pos, 1.0);
+	gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+	vec3 lightDir = normalize(lightPos - pos);
+	vec3 normal = normalize(normalDepth.xyz * 2.0 - 1.0);
+	float diffuse =  pow(dot(normal, lightDir), 2);
+	color = vec4(diffuse * albedo.rgb, 1);
+}
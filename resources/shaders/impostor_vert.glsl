@@ -0,0 +1,60 @@
+#version  330 core
+layout(location = 0) in vec4 vertPos;
+layout(location = 1) in vec3 vertNor;
+layout(location = 2) in vec2 vertTex;
+// mesh decode constants (Shape::init): position = bias + vertPos * scale
+layout(location = 3) in vec4 vertDecodeBias;
+layout(location = 4) in vec4 vertDecodeScale;
+// per instance (InstanceBatch)
+layout(location = 5) in mat4 instM;
+layout(location = 9) in vec4 instParams;
+layout(std140) uniform Camera
+{
+	mat4 P;
+	mat4 V;
+	mat4 PV;
+	vec4 viewport;
+	vec4 time;
+};
+// bounding sphere of the baked shape and the atlas layout (Impostor)
+uniform vec3 impostorCenter;
+uniform float impostorRadius;
+uniform int impostorViews;
+out vec2 fragTex;
+out vec3 fragPos;
+out vec3 fragDir;
+out float fragRadius;
+
+vec2 octEncode(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.xy;
+	if (n.z < 0.0)
+	{
+		e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return e;
+}
+
+void main()
+{
+	vec3 center = (instM * vec4(impostorCenter, 1.0)).xyz;
+	float scale = max(length(instM[0].xyz), max(length(instM[1].xyz), length(instM[2].xyz)));
+	vec3 eye = -transpose(mat3(V)) * V[3].xyz;
+	vec3 dir = normalize(eye - center);
+
+	// the view baked closest to the direction the object is seen from
+	ivec2 cell = clamp(ivec2((octEncode(dir) * 0.5 + 0.5) * float(impostorViews)), ivec2(0), ivec2(impostorViews - 1));
+
+	// same basis as the lookAt of the bake
+	vec3 up = abs(dir.y) > 0.999 ? vec3(0, 0, 1) : vec3(0, 1, 0);
+	vec3 right = normalize(cross(up, dir));
+	up = cross(dir, right);
+
+	vec2 corner = vertDecodeBias.xy + vertPos.xy * vertDecodeScale.xy;
+	fragRadius = impostorRadius * scale;
+	fragPos = center + (right * corner.x + up * corner.y) * fragRadius;
+	fragTex = (vec2(cell) + corner * 0.5 + 0.5) / float(impostorViews);
+	fragDir = dir;
+	gl_Position = PV * vec4(fragPos, 1.0);
+}
@@ -0,0 +1,43 @@
+#version  330 core
+layout(location = 0) in vec4 vertPos;
+layout(location = 1) in vec3 vertNor;
+layout(location = 2) in vec2 vertTex;
+// mesh decode constants (Shape::init): position = bias + vertPos * scale,
+// scale.w = 1 when vertNor holds an octahedral normal in xy
+layout(location = 3) in vec4 vertDecodeBias;
+layout(location = 4) in vec4 vertDecodeScale;
+// per instance (InstanceBatch)
+layout(location = 5) in mat4 instM;
+layout(location = 9) in vec4 instParams;
+layout(std140) uniform Camera
+{
+	mat4 P;
+	mat4 V;
+	mat4 PV;
+	vec4 viewport;
+	vec4 time;
+};
+out vec3 fragNor;
+out vec3 fragPos;
+out vec4 fragParams;
+
+vec3 octDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+	{
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(n);
+}
+
+void main()
+{
+	vec4 pos = vec4(vertDecodeBias.xyz + vertPos.xyz * vertDecodeScale.xyz, 1.0);
+	vec3 nor = vertDecodeScale.w > 0.5 ? octDecode(vertNor.xy) : vertNor;
+	gl_Position = PV * instM * pos;
+	// instances are scaled uniformly, so the upper 3x3 serves as the normal matrix
+	fragNor = normalize(mat3(instM) * nor);
+	fragPos = (instM * pos).xyz;
+	fragParams = instParams;
+}
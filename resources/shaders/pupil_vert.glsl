@@ -2,16 +2,46 @@
 layout(location = 0) in vec4 vertPos;
 layout(location = 1) in vec3 vertNor;
 layout(location = 2) in vec2 vertTex;
-uniform mat4 P;
-uniform mat4 V;
-uniform mat4 M;
+// mesh decode constants (Shape::init): position = bias + vertPos * scale,
+// scale.w = 1 when vertNor holds an octahedral normal in xy
+layout(location = 3) in vec4 vertDecodeBias;
+layout(location = 4) in vec4 vertDecodeScale;
+layout(std140) uniform Camera
+{
+	mat4 P;
+	mat4 V;
+	mat4 PV;
+	vec4 viewport;
+	vec4 time;
+};
+// per-object data (RenderQueue): M, normal matrix, params
+uniform samplerBuffer objectData;
+uniform int objectIndex;
 out vec3 fragNor;
 out vec3 fragPos;
 
+vec3 octDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+	{
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(n);
+}
+
 void main()
 {
-	gl_Position = P * V * M * vertPos;
-	fragNor = (M * vec4(vertNor, 1)).xyz;
-	fragPos = (M * vec4(vertPos.xyz, 1)).xyz;
+	int base = objectIndex * 8;
+	mat4 M = mat4(texelFetch(objectData, base), texelFetch(objectData, base + 1),
+		texelFetch(objectData, base + 2), texelFetch(objectData, base + 3));
+	mat3 N = mat3(texelFetch(objectData, base + 4).xyz, texelFetch(objectData, base + 5).xyz,
+		texelFetch(objectData, base + 6).xyz);
+
+	vec4 pos = vec4(vertDecodeBias.xyz + vertPos.xyz * vertDecodeScale.xyz, 1.0);
+	vec3 nor = vertDecodeScale.w > 0.5 ? octDecode(vertNor.xy) : vertNor;
+	gl_Position = PV * M * pos;
+	fragNor = N * nor;
+	fragPos = (M * pos).xyz;
 
 }
@@ -0,0 +1,37 @@
+#version 330 core 
+in vec3 fragPos;
+flat in vec3 fragCenter;
+flat in float fragRadius;
+flat in vec4 fragColor;
+out vec4 color;
+layout(std140) uniform Camera
+{
+	mat4 P;
+	mat4 V;
+	mat4 PV;
+	vec4 viewport;
+	vec4 time;
+};
+
+vec3 lightPos = vec3(-100,-100,-100);
+
+void main()
+{
+	// nearest t with |t * ray - center| = radius
+	vec3 ray = normalize(fragPos);
+	float b = dot(ray, fragCenter);
+	float h = b * b - dot(fragCenter, fragCenter) + fragRadius * fragRadius;
+	if (h < 0.0)
+	{
+		discard;
+	}
+	vec3 hit = ray * (b - sqrt(h));
+	vec3 normal = (hit - fragCenter) / fragRadius;
+
+	vec4 clip = P * vec4(hit, 1.0);
+	gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+	vec3 lightDir = normalize((V * vec4(lightPos, 1.0)).xyz - hit);
+	float diffuse = max(dot(normal, lightDir), 0.0);
+	color = vec4(fragColor.rgb * (0.4 + 0.6 * diffuse), fragColor.a);
+}
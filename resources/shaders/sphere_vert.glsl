@@ -0,0 +1,46 @@
+#version  330 core
+layout(location = 0) in vec4 vertPos;
+layout(location = 1) in vec3 vertNor;
+layout(location = 2) in vec2 vertTex;
+// mesh decode constants (Shape::init): position = bias + vertPos * scale
+layout(location = 3) in vec4 vertDecodeBias;
+layout(location = 4) in vec4 vertDecodeScale;
+// per instance (InstanceBatch): translate * uniform scale of a unit sphere,
+// params = colour
+layout(location = 5) in mat4 instM;
+layout(location = 9) in vec4 instParams;
+layout(std140) uniform Camera
+{
+	mat4 P;
+	mat4 V;
+	mat4 PV;
+	vec4 viewport;
+	vec4 time;
+};
+// view space, the fragment shader casts a ray from the origin through fragPos
+out vec3 fragPos;
+flat out vec3 fragCenter;
+flat out float fragRadius;
+flat out vec4 fragColor;
+
+void main()
+{
+	vec3 center = (V * vec4(instM[3].xyz, 1.0)).xyz;
+	float radius = length(instM[0].xyz);
+	float dist = max(length(center), radius * 1.0001);
+	vec3 dir = center / dist;
+
+	// The quad faces the eye at the front of the sphere and is just large
+	// enough to hold the cone of rays touching it
+	vec3 up = abs(dir.y) > 0.999 ? vec3(1, 0, 0) : vec3(0, 1, 0);
+	vec3 right = normalize(cross(dir, up));
+	up = cross(right, dir);
+	float size = radius * sqrt((dist - radius) / (dist + radius));
+
+	vec2 corner = vertDecodeBias.xy + vertPos.xy * vertDecodeScale.xy;
+	fragPos = center - dir * radius + (right * corner.x + up * corner.y) * size;
+	fragCenter = center;
+	fragRadius = radius;
+	fragColor = instParams;
+	gl_Position = P * vec4(fragPos, 1.0);
+}
@@ -0,0 +1,145 @@
+// M_PI on MSVC, before anything pulls in <cmath>
+#define _USE_MATH_DEFINES
+#include "AOBaker.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <glm/glm.hpp>
+
+#include "MeshBVH.h"
+
+using namespace std;
+using namespace glm;
+
+// bump when the bake changes, so old cache files are ignored
+static const uint32_t CACHE_VERSION = 2;
+
+// van der Corput sequence, the second Hammersley coordinate
+static float radicalInverse(uint32_t i)
+{
+	i = (i << 16) | (i >> 16);
+	i = ((i & 0x55555555u) << 1) | ((i & 0xAAAAAAAAu) >> 1);
+	i = ((i & 0x33333333u) << 2) | ((i & 0xCCCCCCCCu) >> 2);
+	i = ((i & 0x0F0F0F0Fu) << 4) | ((i & 0xF0F0F0F0u) >> 4);
+	i = ((i & 0x00FF00FFu) << 8) | ((i & 0xFF00FF00u) >> 8);
+	return i * 2.3283064365386963e-10f;
+}
+
+// per vertex rotation of the ray set, in [0, 1)
+static float vertexAngle(uint32_t v)
+{
+	v ^= v >> 16;
+	v *= 0x7feb352du;
+	v ^= v >> 15;
+	v *= 0x846ca68bu;
+	v ^= v >> 16;
+	return (v >> 8) * (1.0f / 16777216.0f);
+}
+
+void AOBaker::bake(const vector<float> &positions, const vector<float> &normals, const MeshBVH &bvh,
+	int rays, float maxDistance, vector<uint8_t> &ao, WorkerPool *pool)
+{
+	int numVerts = (int)(positions.size() / 3);
+	ao.assign(numVerts, 255);
+	if (normals.size() < positions.size() || rays <= 0)
+	{
+		return;
+	}
+
+	// Hammersley points mapped to a cosine-weighted hemisphere around +z,
+	// so the fraction of rays that escape is the cosine-weighted visibility
+	vector<vec3> dirs(rays);
+	for (int i = 0; i < rays; i++)
+	{
+		float u = (i + 0.5f) / rays;
+		float phi = 2.0f * (float)M_PI * radicalInverse((uint32_t)i);
+		float r = sqrt(u);
+		dirs[i] = vec3(r * cos(phi), r * sin(phi), sqrt(1.0f - u));
+	}
+
+	// keeps rays from hitting the triangles around their own vertex
+	float bias = maxDistance * 1e-3f;
+
+	pool->parallelFor(numVerts, 64, [&](int begin, int end) {
+		for (int v = begin; v < end; v++)
+		{
+			vec3 p(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+			vec3 n(normals[v * 3], normals[v * 3 + 1], normals[v * 3 + 2]);
+			if (length(n) < 1e-6f)
+			{
+				continue;
+			}
+			n = normalize(n);
+
+			float angle = 2.0f * (float)M_PI * vertexAngle((uint32_t)v);
+			vec3 t = normalize(cross(fabs(n.x) > 0.9f ? vec3(0, 1, 0) : vec3(1, 0, 0), n));
+			vec3 b = cross(n, t);
+			vec3 tangent = t * cos(angle) + b * sin(angle);
+			vec3 bitangent = cross(n, tangent);
+
+			vec3 origin = p + n * bias;
+			int open = 0;
+			for (int i = 0; i < rays; i++)
+			{
+				vec3 dir = tangent * dirs[i].x + bitangent * dirs[i].y + n * dirs[i].z;
+				if (!bvh.occluded(origin, dir, maxDistance))
+				{
+					open++;
+				}
+			}
+			ao[v] = (uint8_t)((open * 255 + rays / 2) / rays);
+		}
+	});
+}
+
+uint64_t AOBaker::hashMesh(const vector<float> &positions, const vector<float> &normals,
+	const vector<unsigned int> &indices, int rays, float maxDistance)
+{
+	uint64_t hash = 14695981039346656037ull;
+	const unsigned char *blocks[] = {(const unsigned char *)positions.data(), (const unsigned char *)normals.data(),
+		(const unsigned char *)indices.data(), (const unsigned char *)&rays, (const unsigned char *)&maxDistance,
+		(const unsigned char *)&CACHE_VERSION};
+	size_t sizes[] = {positions.size() * sizeof(float), normals.size() * sizeof(float),
+		indices.size() * sizeof(unsigned int), sizeof(rays), sizeof(maxDistance), sizeof(CACHE_VERSION)};
+	for (int b = 0; b < 6; b++)
+	{
+		for (size_t i = 0; i < sizes[b]; i++)
+		{
+			hash ^= blocks[b][i];
+			hash *= 1099511628211ull;
+		}
+	}
+	return hash;
+}
+
+string AOBaker::cacheFile(const string &directory, uint64_t hash)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "ao_%016llx.bin", (unsigned long long)hash);
+	return directory.empty() ? string(name) : directory + "/" + name;
+}
+
+bool AOBaker::load(const string &file, size_t vertices, vector<uint8_t> &ao)
+{
+	ifstream in(file, ios::binary);
+	uint64_t count = 0;
+	if (!in.read((char *)&count, sizeof(count)) || count != vertices)
+	{
+		return false;
+	}
+	ao.resize(vertices);
+	return vertices == 0 || (bool)in.read((char *)&ao[0], vertices);
+}
+
+bool AOBaker::save(const string &file, const vector<uint8_t> &ao)
+{
+	ofstream out(file, ios::binary);
+	uint64_t count = ao.size();
+	out.write((const char *)&count, sizeof(count));
+	if (!ao.empty())
+	{
+		out.write((const char *)&ao[0], ao.size());
+	}
+	return (bool)out;
+}
@@ -0,0 +1,44 @@
+/*
+ * Per-vertex ambient occlusion, baked on the CPU.
+ *
+ * Every vertex casts a fixed set of cosine-weighted rays over the
+ * hemisphere around its normal against the mesh's triangle BVH. The
+ * fraction that escape within maxDistance is the vertex's AO, stored as one
+ * byte. Vertices are spread over the worker pool. The ray set is rotated per
+ * vertex, which trades banding for noise that the interpolation between
+ * vertices smooths out.
+ *
+ * Results are cached on disk, one file per mesh named by a hash of its
+ * positions, normals, indices and the bake settings, so a mesh is only baked
+ * again when its geometry changes.
+ */
+
+#pragma once
+#ifndef AOBAKER_H
+#define AOBAKER_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "WorkerPool.h"
+
+class MeshBVH;
+
+namespace AOBaker
+{
+	// normals has 3 floats per vertex like positions, ao receives a byte per vertex
+	void bake(const std::vector<float> &positions, const std::vector<float> &normals, const MeshBVH &bvh,
+		int rays, float maxDistance, std::vector<uint8_t> &ao, WorkerPool *pool = &WorkerPool::shared());
+
+	// FNV-1a over the geometry and the settings
+	uint64_t hashMesh(const std::vector<float> &positions, const std::vector<float> &normals,
+		const std::vector<unsigned int> &indices, int rays, float maxDistance);
+	std::string cacheFile(const std::string &directory, uint64_t hash);
+
+	// false if the file is missing or holds a different number of vertices
+	bool load(const std::string &file, size_t vertices, std::vector<uint8_t> &ao);
+	bool save(const std::string &file, const std::vector<uint8_t> &ao);
+}
+
+#endif // AOBAKER_H
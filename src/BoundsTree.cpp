@@ -0,0 +1,151 @@
+#include "BoundsTree.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace glm;
+
+void BoundsTree::clear()
+{
+	nodes.clear();
+	items.clear();
+}
+
+void BoundsTree::build(const vector<vec3> &mins, const vector<vec3> &maxs, int leafSize)
+{
+	clear();
+	int n = (int)mins.size();
+	if (n == 0)
+	{
+		return;
+	}
+	leafSize = (std::max)(leafSize, 1);
+
+	vector<vec3> centroids(n);
+	items.resize(n);
+	for (int i = 0; i < n; i++)
+	{
+		items[i] = i;
+		centroids[i] = (mins[i] + maxs[i]) * 0.5f;
+	}
+
+	struct Range { int node, start, end; };
+	vector<Range> stack;
+	nodes.reserve(2 * n / leafSize + 1);
+	nodes.push_back(BoundsNode());
+	stack.push_back({0, 0, n});
+
+	while (!stack.empty())
+	{
+		Range r = stack.back();
+		stack.pop_back();
+
+		vec3 bmin = mins[items[r.start]];
+		vec3 bmax = maxs[items[r.start]];
+		vec3 cmin = centroids[items[r.start]];
+		vec3 cmax = cmin;
+		for (int i = r.start + 1; i < r.end; i++)
+		{
+			int item = items[i];
+			bmin = glm::min(bmin, mins[item]);
+			bmax = glm::max(bmax, maxs[item]);
+			cmin = glm::min(cmin, centroids[item]);
+			cmax = glm::max(cmax, centroids[item]);
+		}
+
+		BoundsNode &node = nodes[r.node];
+		node.min = bmin;
+		node.max = bmax;
+
+		vec3 extent = cmax - cmin;
+		int count = r.end - r.start;
+		if (count <= leafSize || (extent.x <= 0 && extent.y <= 0 && extent.z <= 0))
+		{
+			node.first = r.start;
+			node.count = count;
+			continue;
+		}
+
+		// median split along the widest axis of the centroids
+		int axis = 0;
+		if (extent.y > extent[axis]) axis = 1;
+		if (extent.z > extent[axis]) axis = 2;
+		int mid = r.start + count / 2;
+		nth_element(items.begin() + r.start, items.begin() + mid, items.begin() + r.end,
+			[&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+
+		int left = (int)nodes.size();
+		node.first = left;
+		node.count = 0;
+		// node is invalidated here, nodes may reallocate
+		nodes.push_back(BoundsNode());
+		nodes.push_back(BoundsNode());
+		stack.push_back({left, r.start, mid});
+		stack.push_back({left + 1, mid, r.end});
+	}
+}
+
+void BoundsTree::queryBox(const vec3 &min, const vec3 &max, vector<int> &out) const
+{
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const BoundsNode &node = nodes[stack[--top]];
+		if (node.min.x > max.x || node.max.x < min.x ||
+			node.min.y > max.y || node.max.y < min.y ||
+			node.min.z > max.z || node.max.z < min.z)
+		{
+			continue;
+		}
+		if (node.count > 0)
+		{
+			for (int i = 0; i < node.count; i++)
+			{
+				out.push_back(items[node.first + i]);
+			}
+		}
+		else
+		{
+			stack[top++] = node.first;
+			stack[top++] = node.first + 1;
+		}
+	}
+}
+
+bool BoundsTree::intersectRay(const vec3 &origin, const vec3 &invDir,
+	const vec3 &min, const vec3 &max, float maxT, float &tEnter)
+{
+	float t0 = 0;
+	float t1 = maxT;
+	for (int a = 0; a < 3; a++)
+	{
+		float tNear = (min[a] - origin[a]) * invDir[a];
+		float tFar = (max[a] - origin[a]) * invDir[a];
+		if (tNear > tFar)
+		{
+			std::swap(tNear, tFar);
+		}
+		// NaN (0 * inf) compares false and leaves the interval alone
+		t0 = tNear > t0 ? tNear : t0;
+		t1 = tFar < t1 ? tFar : t1;
+		if (t0 > t1)
+		{
+			return false;
+		}
+	}
+	tEnter = t0;
+	return true;
+}
+
+float BoundsTree::distance2(const vec3 &p, const vec3 &min, const vec3 &max)
+{
+	vec3 d = glm::max(glm::max(min - p, p - max), vec3(0));
+	return dot(d, d);
+}
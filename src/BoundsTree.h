@@ -0,0 +1,45 @@
+/*
+ * Bounding volume hierarchy over a set of axis aligned boxes.
+ *
+ * The tree only stores item indices, so the same builder is used for
+ * objects in a scene and for triangles in a mesh. Nodes are kept in one flat
+ * array; the children of an inner node are always stored next to each other.
+ */
+
+#pragma once
+#ifndef BOUNDSTREE_H
+#define BOUNDSTREE_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+struct BoundsNode
+{
+	glm::vec3 min;
+	int first; // leaf: first entry in BoundsTree::items, inner: index of the left child
+	glm::vec3 max;
+	int count; // leaf: number of items, inner: 0
+};
+
+class BoundsTree
+{
+public:
+	void build(const std::vector<glm::vec3> &mins, const std::vector<glm::vec3> &maxs, int leafSize = 4);
+	void clear();
+	bool empty() const { return nodes.empty(); }
+
+	// appends every item whose box overlaps [min, max]
+	void queryBox(const glm::vec3 &min, const glm::vec3 &max, std::vector<int> &out) const;
+
+	// slab test, tEnter is the entry distance along the ray (0 if the origin is inside)
+	static bool intersectRay(const glm::vec3 &origin, const glm::vec3 &invDir,
+		const glm::vec3 &min, const glm::vec3 &max, float maxT, float &tEnter);
+
+	// squared distance from a point to a box, 0 inside
+	static float distance2(const glm::vec3 &p, const glm::vec3 &min, const glm::vec3 &max);
+
+	std::vector<BoundsNode> nodes;
+	std::vector<int> items;
+};
+
+#endif // BOUNDSTREE_H
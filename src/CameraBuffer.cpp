@@ -0,0 +1,38 @@
+#include "CameraBuffer.h"
+
+#include "GLSL.h"
+#include "GLState.h"
+
+CameraBuffer::CameraBuffer() :
+	bufferID(0)
+{
+}
+
+CameraBuffer::~CameraBuffer()
+{
+	if (bufferID != 0)
+	{
+		GLState::deleteBuffer(bufferID);
+	}
+}
+
+void CameraBuffer::init()
+{
+	CHECKED_GL_CALL(glGenBuffers(1, &bufferID));
+	CHECKED_GL_CALL(GLState::bindBuffer(GL_UNIFORM_BUFFER, bufferID));
+	CHECKED_GL_CALL(glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), NULL, GL_DYNAMIC_DRAW));
+	CHECKED_GL_CALL(GLState::bindBufferBase(GL_UNIFORM_BUFFER, GLSL::BINDING_CAMERA, bufferID));
+}
+
+void CameraBuffer::update(const glm::mat4 &P, const glm::mat4 &V, const glm::vec4 &viewport, float time, float frameTime)
+{
+	Block block;
+	block.P = P;
+	block.V = V;
+	block.PV = P * V;
+	block.viewport = viewport;
+	block.time = glm::vec4(time, frameTime, 0, 0);
+
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, bufferID);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+}
@@ -0,0 +1,51 @@
+/*
+ * Per-frame camera constants shared by every program.
+ *
+ * Filled once per frame into a std140 uniform block that the shaders declare
+ * as
+ *
+ *   layout(std140) uniform Camera
+ *   {
+ *       mat4 P;
+ *       mat4 V;
+ *       mat4 PV;
+ *       vec4 viewport; // x, y, width, height in pixels
+ *       vec4 time; // x = seconds since start, y = frame time
+ *   };
+ *
+ * Program::init attaches any block named Camera to GLSL::BINDING_CAMERA, so
+ * binding the buffer there once covers every program.
+ */
+
+#pragma once
+#ifndef CAMERABUFFER_H
+#define CAMERABUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+class CameraBuffer
+{
+public:
+	CameraBuffer();
+	~CameraBuffer();
+
+	// needs a GL context, call once before the first update()
+	void init();
+	void update(const glm::mat4 &P, const glm::mat4 &V, const glm::vec4 &viewport, float time, float frameTime);
+
+private:
+	// must match the std140 layout above
+	struct Block
+	{
+		glm::mat4 P;
+		glm::mat4 V;
+		glm::mat4 PV;
+		glm::vec4 viewport;
+		glm::vec4 time;
+	};
+
+	GLuint bufferID;
+};
+
+#endif // CAMERABUFFER_H
@@ -0,0 +1,284 @@
+#include "FrustumCuller.h"
+
+#include <chrono>
+#include <cfloat>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+#include "physics/GameObject.h"
+
+using namespace std;
+using namespace glm;
+
+enum Containment
+{
+	OUTSIDE,
+	INTERSECTS,
+	INSIDE
+};
+
+FrustumCuller::FrustumCuller() :
+	visible(0),
+	nodesVisited(0),
+	cullTime(0)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		planeX[i] = planeY[i] = planeZ[i] = 0;
+		planeD[i] = 1;
+	}
+}
+
+void FrustumCuller::build(const vector<GameObject *> &objects)
+{
+	this->objects = objects;
+	int n = (int)objects.size();
+	vector<vec3> mins(n), maxs(n), centers(n), extents(n);
+	vector<float> radii(n);
+	for (int i = 0; i < n; i++)
+	{
+		const GameObject *object = objects[i];
+		if (object->model == NULL)
+		{
+			centers[i] = mins[i] = maxs[i] = object->position;
+			extents[i] = vec3(0);
+			radii[i] = 0;
+			continue;
+		}
+		mat4 M = object->getModelMatrix();
+		vec3 localCenter = (object->model->min + object->model->max) * 0.5f;
+		vec3 localExtent = (object->model->max - object->model->min) * 0.5f;
+
+		// the box of the transformed box, and a sphere scaled by the largest axis
+		mat3 R = mat3(M);
+		mat3 absR = mat3(glm::abs(R[0]), glm::abs(R[1]), glm::abs(R[2]));
+		centers[i] = vec3(M * vec4(localCenter, 1));
+		extents[i] = absR * localExtent;
+		radii[i] = length(localExtent) * (std::max)((std::max)(length(R[0]), length(R[1])), length(R[2]));
+		mins[i] = centers[i] - extents[i];
+		maxs[i] = centers[i] + extents[i];
+	}
+	tree.build(mins, maxs);
+
+	// leaves read 4 lanes from their first item on
+	size_t padded = (n + 3) & ~3;
+	centerX.assign(padded + 4, 0);
+	centerY.assign(padded + 4, 0);
+	centerZ.assign(padded + 4, 0);
+	radius.assign(padded + 4, 0);
+	extentX.assign(padded + 4, 0);
+	extentY.assign(padded + 4, 0);
+	extentZ.assign(padded + 4, 0);
+	for (int i = 0; i < n; i++)
+	{
+		int item = tree.items[i];
+		centerX[i] = centers[item].x;
+		centerY[i] = centers[item].y;
+		centerZ[i] = centers[item].z;
+		radius[i] = radii[item];
+		extentX[i] = extents[item].x;
+		extentY[i] = extents[item].y;
+		extentZ[i] = extents[item].z;
+	}
+}
+
+void FrustumCuller::extractPlanes(const mat4 &PV, vec4 planes[6])
+{
+	// rows of PV, glm is column major
+	vec4 row[4];
+	for (int r = 0; r < 4; r++)
+	{
+		row[r] = vec4(PV[0][r], PV[1][r], PV[2][r], PV[3][r]);
+	}
+	for (int axis = 0; axis < 3; axis++)
+	{
+		planes[axis * 2] = row[3] + row[axis];
+		planes[axis * 2 + 1] = row[3] - row[axis];
+	}
+	for (int i = 0; i < 6; i++)
+	{
+		planes[i] = planes[i] / length(vec3(planes[i]));
+	}
+}
+
+#ifdef FRUSTUM_SSE
+
+static inline __m128 abs4(__m128 v)
+{
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+
+// one box against all planes, four planes per step
+static Containment classify(const BoundsNode &node, const float *px, const float *py, const float *pz, const float *pd)
+{
+	vec3 c = (node.min + node.max) * 0.5f;
+	vec3 e = (node.max - node.min) * 0.5f;
+	__m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+	__m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+	int crossing = 0;
+	for (int p = 0; p < 8; p += 4)
+	{
+		__m128 nx = _mm_loadu_ps(px + p), ny = _mm_loadu_ps(py + p), nz = _mm_loadu_ps(pz + p);
+		__m128 s = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+			_mm_add_ps(_mm_mul_ps(nz, cz), _mm_loadu_ps(pd + p)));
+		__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs4(nx), ex), _mm_mul_ps(abs4(ny), ey)), _mm_mul_ps(abs4(nz), ez));
+		if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(s, r), _mm_setzero_ps())) != 0)
+		{
+			return OUTSIDE;
+		}
+		crossing |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(s, r), _mm_setzero_ps()));
+	}
+	return crossing != 0 ? INTERSECTS : INSIDE;
+}
+
+// leaves hold up to 4 objects, more only when their centers coincide
+void FrustumCuller::testLeaf(const BoundsNode &node)
+{
+	for (int first = node.first; first < node.first + node.count; first += 4)
+	{
+		__m128 cx = _mm_loadu_ps(&centerX[first]), cy = _mm_loadu_ps(&centerY[first]), cz = _mm_loadu_ps(&centerZ[first]);
+		__m128 ex = _mm_loadu_ps(&extentX[first]), ey = _mm_loadu_ps(&extentY[first]), ez = _mm_loadu_ps(&extentZ[first]);
+		__m128 rad = _mm_loadu_ps(&radius[first]);
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 nx = _mm_set1_ps(planeX[p]), ny = _mm_set1_ps(planeY[p]), nz = _mm_set1_ps(planeZ[p]);
+			__m128 s = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+				_mm_add_ps(_mm_mul_ps(nz, cz), _mm_set1_ps(planeD[p])));
+			__m128 boxR = _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs4(nx), ex), _mm_mul_ps(abs4(ny), ey)), _mm_mul_ps(abs4(nz), ez));
+			// both volumes contain the object, the tighter one decides
+			__m128 r = _mm_min_ps(rad, boxR);
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(s, r), _mm_setzero_ps()));
+		}
+		int mask = _mm_movemask_ps(outside);
+		int count = (std::min)(4, node.first + node.count - first);
+		for (int i = 0; i < count; i++)
+		{
+			bool in = (mask & (1 << i)) == 0;
+			objects[tree.items[first + i]]->inView = in;
+			visible += in ? 1 : 0;
+		}
+	}
+}
+
+#else
+
+static Containment classify(const BoundsNode &node, const float *px, const float *py, const float *pz, const float *pd)
+{
+	vec3 c = (node.min + node.max) * 0.5f;
+	vec3 e = (node.max - node.min) * 0.5f;
+	bool crossing = false;
+	for (int p = 0; p < 6; p++)
+	{
+		float s = px[p] * c.x + py[p] * c.y + pz[p] * c.z + pd[p];
+		float r = fabs(px[p]) * e.x + fabs(py[p]) * e.y + fabs(pz[p]) * e.z;
+		if (s + r < 0)
+		{
+			return OUTSIDE;
+		}
+		crossing = crossing || s - r < 0;
+	}
+	return crossing ? INTERSECTS : INSIDE;
+}
+
+void FrustumCuller::testLeaf(const BoundsNode &node)
+{
+	for (int i = node.first; i < node.first + node.count; i++)
+	{
+		bool in = true;
+		for (int p = 0; p < 6 && in; p++)
+		{
+			float s = planeX[p] * centerX[i] + planeY[p] * centerY[i] + planeZ[p] * centerZ[i] + planeD[p];
+			float boxR = fabs(planeX[p]) * extentX[i] + fabs(planeY[p]) * extentY[i] + fabs(planeZ[p]) * extentZ[i];
+			in = s + (std::min)(radius[i], boxR) >= 0;
+		}
+		objects[tree.items[i]]->inView = in;
+		visible += in ? 1 : 0;
+	}
+}
+
+#endif
+
+// the whole subtree is inside, no more plane tests
+void FrustumCuller::accept(int node)
+{
+	int stack[64];
+	int top = 0;
+	stack[top++] = node;
+	while (top > 0)
+	{
+		const BoundsNode &n = tree.nodes[stack[--top]];
+		if (n.count > 0)
+		{
+			for (int i = 0; i < n.count; i++)
+			{
+				objects[tree.items[n.first + i]]->inView = true;
+			}
+			visible += n.count;
+		}
+		else
+		{
+			stack[top++] = n.first;
+			stack[top++] = n.first + 1;
+		}
+	}
+}
+
+int FrustumCuller::cull(const mat4 &PV)
+{
+	auto start = chrono::high_resolution_clock::now();
+
+	vec4 planes[6];
+	extractPlanes(PV, planes);
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = planes[p].x;
+		planeY[p] = planes[p].y;
+		planeZ[p] = planes[p].z;
+		planeD[p] = planes[p].w;
+	}
+
+	visible = 0;
+	nodesVisited = 0;
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		objects[i]->inView = false;
+	}
+
+	if (!tree.empty())
+	{
+		int stack[64];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0)
+		{
+			int index = stack[--top];
+			const BoundsNode &node = tree.nodes[index];
+			nodesVisited++;
+			Containment containment = classify(node, planeX, planeY, planeZ, planeD);
+			if (containment == OUTSIDE)
+			{
+				continue;
+			}
+			if (containment == INSIDE)
+			{
+				accept(index);
+			}
+			else if (node.count > 0)
+			{
+				testLeaf(node);
+			}
+			else
+			{
+				stack[top++] = node.first;
+				stack[top++] = node.first + 1;
+			}
+		}
+	}
+
+	cullTime = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - start).count();
+	return visible;
+}
@@ -0,0 +1,64 @@
+/*
+ * View frustum culling for GameObjects.
+ *
+ * build() puts the world bounds of every object into a BoundsTree and keeps
+ * a bounding sphere and box per object, stored in tree order as separate
+ * x/y/z arrays. cull() extracts the six planes from P * V and walks the
+ * tree: a node entirely outside rejects its subtree, a node entirely inside
+ * accepts it without further tests. Objects in the remaining leaves are
+ * tested four at a time with SSE, sphere and box against each plane.
+ * The result is written to GameObject::inView.
+ */
+
+#pragma once
+#ifndef FRUSTUMCULLER_H
+#define FRUSTUMCULLER_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "BoundsTree.h"
+
+class GameObject;
+
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+
+	// Call after the objects moved, before cull()
+	void build(const std::vector<GameObject *> &objects);
+
+	// Sets inView on every object given to build(), returns how many are visible
+	int cull(const glm::mat4 &PV);
+
+	// counts of the last cull()
+	int getVisible() const { return visible; }
+	int getCulled() const { return (int)objects.size() - visible; }
+	int getNumObjects() const { return (int)objects.size(); }
+	int getNodesVisited() const { return nodesVisited; }
+	float getCullTime() const { return cullTime; } // milliseconds
+
+	// planes as (n, d) with dot(n, p) + d >= 0 inside, normalized
+	static void extractPlanes(const glm::mat4 &PV, glm::vec4 planes[6]);
+
+private:
+	void accept(int node);
+	void testLeaf(const BoundsNode &node);
+
+	std::vector<GameObject *> objects;
+	BoundsTree tree;
+
+	// per object, in tree item order, padded to a multiple of 4
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<float> extentX, extentY, extentZ; // world box half size, around the sphere center
+
+	// planes split into components, padded to 8 with planes nothing is behind
+	float planeX[8], planeY[8], planeZ[8], planeD[8];
+
+	int visible;
+	int nodesVisited;
+	float cullTime;
+};
+
+#endif // FRUSTUMCULLER_H
@@ -14,6 +14,37 @@
 
 namespace GLSL
 {
+	// Vertex attribute locations shared by every shader (the shaders declare
+	// them with layout(location = ...), Program::init binds them by name too)
+	enum AttribLocation
+	{
+		ATTRIB_POS = 0,
+		ATTRIB_NOR = 1,
+		ATTRIB_TEX = 2,
+		ATTRIB_DECODE_BIAS = 3, // per-mesh vertex decode constants, see Shape::init
+		ATTRIB_DECODE_SCALE = 4,
+		ATTRIB_INSTANCE_M = 5, // mat4, takes 5 to 8, see InstanceBatch
+		ATTRIB_INSTANCE_PARAMS = 9,
+		ATTRIB_AO = 10 // baked per-vertex ambient occlusion, see Shape::bakeAO
+	};
+
+	// Uniform block binding points, attached by name in Program::init
+	enum BlockBinding
+	{
+		BINDING_CAMERA = 0, // "Camera", see CameraBuffer
+		BINDING_LIGHTS = 1 // "Lights", see LightClusters
+	};
+
+	// Texture units of samplers set by name in Program::init
+	enum TextureUnit
+	{
+		UNIT_OBJECT_DATA = 8, // "objectData", see RenderQueue
+		UNIT_IMPOSTOR_COLOR = 9, // "impostorColor", see Impostor
+		UNIT_IMPOSTOR_NORMAL = 10, // "impostorNormal"
+		UNIT_CLUSTER_LIGHTS = 11, // "clusterLights", see LightClusters
+		UNIT_CLUSTER_GRID = 12, // "clusterGrid"
+		UNIT_CLUSTER_INDICES = 13 // "clusterIndices"
+	};
 
 	void printOpenGLErrors(char const * const Function, char const * const File, int const Line);
 	void checkError(const char *str = 0);
@@ -0,0 +1,192 @@
+#include "GLState.h"
+
+#include <vector>
+#include <utility>
+
+// nothing is known about a binding that isn't tracked yet or was invalidated
+static const GLuint UNKNOWN = 0xffffffffu;
+static const int MAX_UNITS = 16;
+
+typedef std::vector<std::pair<GLenum, GLuint> > Bindings;
+
+static GLuint program = UNKNOWN;
+static GLuint vertexArray = UNKNOWN;
+static Bindings buffers; // per target
+static GLenum unit = UNKNOWN;
+static Bindings textures[MAX_UNITS]; // per target, per unit
+static Bindings caps; // 0 / 1 per capability
+
+static int issued = 0;
+static int elided = 0;
+
+// Returns whether the call has to be made, and records the new value
+static bool change(GLuint &current, GLuint value)
+{
+	if (current == value)
+	{
+		elided++;
+		return false;
+	}
+	current = value;
+	issued++;
+	return true;
+}
+
+static GLuint &binding(Bindings &bindings, GLenum target)
+{
+	for (size_t i = 0; i < bindings.size(); i++)
+	{
+		if (bindings[i].first == target)
+		{
+			return bindings[i].second;
+		}
+	}
+	bindings.push_back(std::make_pair(target, UNKNOWN));
+	return bindings.back().second;
+}
+
+static int unitIndex()
+{
+	int index = (int)(unit - GL_TEXTURE0);
+	return unit != UNKNOWN && index >= 0 && index < MAX_UNITS ? index : -1;
+}
+
+static void forget(Bindings &bindings, GLuint name)
+{
+	for (size_t i = 0; i < bindings.size(); i++)
+	{
+		if (bindings[i].second == name)
+		{
+			bindings[i].second = 0;
+		}
+	}
+}
+
+namespace GLState
+{
+
+void useProgram(GLuint id)
+{
+	if (change(program, id))
+	{
+		glUseProgram(id);
+	}
+}
+
+void bindVertexArray(GLuint vao)
+{
+	if (change(vertexArray, vao))
+	{
+		glBindVertexArray(vao);
+		binding(buffers, GL_ELEMENT_ARRAY_BUFFER) = UNKNOWN;
+	}
+}
+
+void bindBuffer(GLenum target, GLuint buffer)
+{
+	if (change(binding(buffers, target), buffer))
+	{
+		glBindBuffer(target, buffer);
+	}
+}
+
+void bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	// indexed bindings aren't tracked, they are rare
+	glBindBufferBase(target, index, buffer);
+	binding(buffers, target) = buffer;
+	issued++;
+}
+
+void activeTexture(GLenum texture)
+{
+	if (change(unit, texture))
+	{
+		glActiveTexture(texture);
+	}
+}
+
+void bindTexture(GLenum target, GLuint texture)
+{
+	int index = unitIndex();
+	if (index < 0)
+	{
+		glBindTexture(target, texture);
+		issued++;
+	}
+	else if (change(binding(textures[index], target), texture))
+	{
+		glBindTexture(target, texture);
+	}
+}
+
+void enable(GLenum cap)
+{
+	if (change(binding(caps, cap), 1))
+	{
+		glEnable(cap);
+	}
+}
+
+void disable(GLenum cap)
+{
+	if (change(binding(caps, cap), 0))
+	{
+		glDisable(cap);
+	}
+}
+
+void deleteBuffer(GLuint buffer)
+{
+	glDeleteBuffers(1, &buffer);
+	forget(buffers, buffer);
+}
+
+void deleteVertexArray(GLuint vao)
+{
+	glDeleteVertexArrays(1, &vao);
+	if (vertexArray == vao)
+	{
+		vertexArray = 0;
+		binding(buffers, GL_ELEMENT_ARRAY_BUFFER) = UNKNOWN;
+	}
+}
+
+void deleteTexture(GLuint texture)
+{
+	glDeleteTextures(1, &texture);
+	for (int i = 0; i < MAX_UNITS; i++)
+	{
+		forget(textures[i], texture);
+	}
+}
+
+void invalidate()
+{
+	program = UNKNOWN;
+	vertexArray = UNKNOWN;
+	unit = UNKNOWN;
+	buffers.clear();
+	for (int i = 0; i < MAX_UNITS; i++)
+	{
+		textures[i].clear();
+	}
+	caps.clear();
+}
+
+void resetStats()
+{
+	issued = elided = 0;
+}
+
+int getIssued()
+{
+	return issued;
+}
+
+int getElided()
+{
+	return elided;
+}
+
+}
@@ -0,0 +1,44 @@
+/*
+ * Mirror of the GL binding state, so redundant binds never reach the driver.
+ *
+ * Binds go through these functions instead of the gl* entry points. A call
+ * that would set what is already bound is dropped and counted as elided.
+ * Objects must be deleted through GLState too, since GL unbinds them and
+ * hands their names out again. Code that changes bindings behind its back
+ * has to call invalidate() afterwards.
+ *
+ * The element array binding is part of the VAO, so it is forgotten whenever
+ * the VAO changes.
+ */
+
+#pragma once
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <glad/glad.h>
+
+namespace GLState
+{
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vao);
+	void bindBuffer(GLenum target, GLuint buffer);
+	void bindBufferBase(GLenum target, GLuint index, GLuint buffer); // also binds target
+	void activeTexture(GLenum unit); // GL_TEXTURE0 + i
+	void bindTexture(GLenum target, GLuint texture); // on the active unit
+	void enable(GLenum cap);
+	void disable(GLenum cap);
+
+	void deleteBuffer(GLuint buffer);
+	void deleteVertexArray(GLuint vao);
+	void deleteTexture(GLuint texture);
+
+	// forget everything, the next call of each kind is issued
+	void invalidate();
+
+	// calls that reached GL / were dropped since resetStats()
+	void resetStats();
+	int getIssued();
+	int getElided();
+}
+
+#endif // GLSTATE_H
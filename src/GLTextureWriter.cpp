@@ -5,6 +5,8 @@
 
 #include <iostream>
 
+#include "GLState.h"
+
 
 /**
  * Retrieve the width of the texture
@@ -96,8 +98,8 @@ bool GLTextureWriter::WriteImage(GLint tid, std::string imgName)
 	GLint backupBoundTexture;
 	glGetIntegerv(GL_TEXTURE_BINDING_2D, &backupBoundTexture);
 
-	//Bind texture to buffer
-	glBindTexture(GL_TEXTURE_2D,tid);
+	//Bind texture to buffer, through GLState so its mirror stays current
+	GLState::bindTexture(GL_TEXTURE_2D, tid);
 
 	//Retrieve width and height
 	int txWidth = getTextureWidth();
@@ -125,7 +127,7 @@ bool GLTextureWriter::WriteImage(GLint tid, std::string imgName)
 	delete [] dataBuffer;
 
 	//Bind old texture
-	glBindTexture(GL_TEXTURE_2D,backupBoundTexture);
+	GLState::bindTexture(GL_TEXTURE_2D, backupBoundTexture);
 
 	return res;
 }
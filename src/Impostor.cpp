@@ -0,0 +1,162 @@
+#include "Impostor.h"
+
+#include <iostream>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "GLSL.h"
+#include "GLState.h"
+#include "Program.h"
+#include "Shape.h"
+
+using namespace std;
+using namespace glm;
+
+// Direction of octahedral coordinates e in [-1, 1]^2, the inverse of
+// octEncode() in impostor_vert.glsl
+static vec3 octDecode(vec2 e)
+{
+	vec3 n(e.x, e.y, 1.0f - fabs(e.x) - fabs(e.y));
+	if (n.z < 0)
+	{
+		float x = (1.0f - fabs(n.y)) * (n.x >= 0 ? 1.0f : -1.0f);
+		float y = (1.0f - fabs(n.x)) * (n.y >= 0 ? 1.0f : -1.0f);
+		n.x = x;
+		n.y = y;
+	}
+	return normalize(n);
+}
+
+Impostor::Impostor(int views, int cellSize) :
+	views(views),
+	cellSize(cellSize),
+	center(0),
+	radius(1),
+	colorTex(0),
+	normalTex(0),
+	baked(false)
+{
+}
+
+Impostor::~Impostor()
+{
+	if (colorTex != 0)
+	{
+		GLState::deleteTexture(colorTex);
+		GLState::deleteTexture(normalTex);
+	}
+}
+
+static GLuint createAtlas(int size)
+{
+	GLuint tex;
+	glGenTextures(1, &tex);
+	GLState::bindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return tex;
+}
+
+bool Impostor::bake(const Shape &shape, Program &bakeProg, const vec3 &baseColor)
+{
+	center = (shape.min + shape.max) * 0.5f;
+	radius = (std::max)(length(shape.max - shape.min) * 0.5f, 1e-6f);
+
+	int size = views * cellSize;
+	if (colorTex == 0)
+	{
+		colorTex = createAtlas(size);
+		normalTex = createAtlas(size);
+	}
+
+	GLuint fbo, depth;
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTex, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTex, 0);
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	GLenum buffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+	glDrawBuffers(2, buffers);
+
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	if (complete)
+	{
+		GLint viewport[4];
+		GLfloat clearColor[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+
+		glViewport(0, 0, size, size);
+		glClearColor(0, 0, 0, 0);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		static const int mvpID = Program::getUniformID("bakeMVP");
+		static const int colorID = Program::getUniformID("baseColor");
+		bakeProg.bind();
+		bakeProg.setUniform(colorID, baseColor);
+		shape.bind();
+
+		// The camera sits 2r from the center looking at it, the depth range
+		// [r, 3r] covers the bounding sphere. Right and up are built from the
+		// direction the same way impostor_vert.glsl builds them.
+		mat4 P = ortho(-radius, radius, -radius, radius, radius, 3 * radius);
+		for (int y = 0; y < views; y++)
+		{
+			for (int x = 0; x < views; x++)
+			{
+				vec2 e = (vec2((float)x, (float)y) + 0.5f) / (float)views * 2.0f - 1.0f;
+				vec3 dir = octDecode(e);
+				vec3 up = fabs(dir.y) > 0.999f ? vec3(0, 0, 1) : vec3(0, 1, 0);
+				mat4 V = lookAt(center + dir * 2.0f * radius, center, up);
+
+				glViewport(x * cellSize, y * cellSize, cellSize, cellSize);
+				bakeProg.setUniform(mvpID, P * V);
+				shape.drawElements();
+			}
+		}
+
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+	}
+	else
+	{
+		cerr << "Impostor framebuffer incomplete" << endl;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteRenderbuffers(1, &depth);
+	glDeleteFramebuffers(1, &fbo);
+	baked = complete;
+	return complete;
+}
+
+void Impostor::draw(Program &prog)
+{
+	if (!isBaked() || instances.size() == 0)
+	{
+		return;
+	}
+
+	static const int centerID = Program::getUniformID("impostorCenter");
+	static const int radiusID = Program::getUniformID("impostorRadius");
+	static const int viewsID = Program::getUniformID("impostorViews");
+	prog.bind();
+	prog.setUniform(centerID, center);
+	prog.setUniform(radiusID, radius);
+	prog.setUniform(viewsID, views);
+
+	GLState::activeTexture(GL_TEXTURE0 + GLSL::UNIT_IMPOSTOR_COLOR);
+	GLState::bindTexture(GL_TEXTURE_2D, colorTex);
+	GLState::activeTexture(GL_TEXTURE0 + GLSL::UNIT_IMPOSTOR_NORMAL);
+	GLState::bindTexture(GL_TEXTURE_2D, normalTex);
+
+	const Shape &quad = *Shape::unitQuad();
+	quad.bind();
+	instances.draw(quad);
+}
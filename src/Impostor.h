@@ -0,0 +1,66 @@
+/*
+ * Billboard stand-in for a mesh seen from far away.
+ *
+ * bake() renders the shape once from VIEWS x VIEWS directions spread over
+ * the sphere with an octahedral mapping, each into its own cell of two
+ * atlases: colour (alpha marks coverage) and normal + depth. The views are
+ * orthographic and fit the shape's bounding sphere, so depth is linear
+ * around its center.
+ *
+ * Fill the instance batch with add() during the frame, then draw() renders
+ * every instance as a quad facing the camera in one instanced call. The
+ * vertex shader picks the cell baked closest to the direction the object is
+ * seen from, the fragment shader relights the baked normals and writes the
+ * baked depth, so impostors still intersect the scene properly.
+ *
+ * The view is picked in world space, which is only right for objects that
+ * are not rotated.
+ */
+
+#pragma once
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "InstanceBatch.h"
+
+class Shape;
+class Program;
+
+class Impostor
+{
+public:
+	// views x views directions, cellSize pixels each
+	Impostor(int views = 8, int cellSize = 64);
+	~Impostor();
+	Impostor(const Impostor &) = delete;
+	Impostor &operator=(const Impostor &) = delete;
+
+	// Renders the atlases with bakeProg (see impostor_bake_*.glsl). Restores
+	// the framebuffer and viewport. Returns false if the framebuffer can't be
+	// created.
+	bool bake(const Shape &shape, Program &bakeProg, const glm::vec3 &baseColor);
+	bool isBaked() const { return baked; } // the last bake() succeeded
+
+	void clear() { instances.clear(); }
+	void add(const glm::mat4 &M) { instances.add(M); }
+	int size() const { return instances.size(); }
+
+	// one instanced draw of everything added since clear(), with prog
+	// (see impostor_*.glsl)
+	void draw(Program &prog);
+
+private:
+	int views;
+	int cellSize;
+	glm::vec3 center; // bounding sphere of the shape, local space
+	float radius;
+	GLuint colorTex;
+	GLuint normalTex;
+	bool baked;
+	InstanceBatch instances;
+};
+
+#endif // IMPOSTOR_H
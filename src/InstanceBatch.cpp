@@ -0,0 +1,69 @@
+#include "InstanceBatch.h"
+
+#include <glad/glad.h>
+
+#include "Shape.h"
+#include "GLState.h"
+
+using namespace std;
+using namespace glm;
+
+InstanceBatch::InstanceBatch() :
+	bufferID(0),
+	capacity(0),
+	dirty(false)
+{
+}
+
+InstanceBatch::~InstanceBatch()
+{
+	if (bufferID != 0)
+	{
+		GLState::deleteBuffer(bufferID);
+	}
+}
+
+void InstanceBatch::clear()
+{
+	instances.clear();
+	dirty = true;
+}
+
+void InstanceBatch::add(const mat4 &M, const vec4 &params)
+{
+	Instance instance;
+	instance.M = M;
+	instance.params = params;
+	instances.push_back(instance);
+	dirty = true;
+}
+
+void InstanceBatch::upload()
+{
+	if (bufferID == 0)
+	{
+		glGenBuffers(1, &bufferID);
+	}
+	GLState::bindBuffer(GL_ARRAY_BUFFER, bufferID);
+	if (instances.size() > capacity)
+	{
+		capacity = instances.size() + instances.size() / 2;
+	}
+	// reallocating every time orphans the storage last frame's draw may still read
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Instance), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(Instance), &instances[0]);
+	dirty = false;
+}
+
+void InstanceBatch::draw(const Shape &shape)
+{
+	if (instances.empty())
+	{
+		return;
+	}
+	if (dirty)
+	{
+		upload();
+	}
+	shape.drawInstanced(bufferID, (int)instances.size());
+}
@@ -0,0 +1,48 @@
+/*
+ * Per-instance data for drawing many copies of one mesh in a single call.
+ *
+ * Fill with add() during the frame, then hand the batch to
+ * RenderQueue::submitInstanced (or call draw() directly with the program and
+ * mesh bound). The instance buffer feeds the GLSL::ATTRIB_INSTANCE_* locations:
+ * a mat4 model matrix and a vec4 of free parameters per instance.
+ */
+
+#pragma once
+#ifndef INSTANCEBATCH_H
+#define INSTANCEBATCH_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+class Shape;
+
+class InstanceBatch
+{
+public:
+	struct Instance
+	{
+		glm::mat4 M;
+		glm::vec4 params;
+	};
+
+	InstanceBatch();
+	~InstanceBatch();
+
+	void clear();
+	void add(const glm::mat4 &M, const glm::vec4 &params = glm::vec4(1));
+	int size() const { return (int)instances.size(); }
+	const std::vector<Instance> &getInstances() const { return instances; }
+
+	// uploads the instances if they changed and draws them all, shape.bind() first
+	void draw(const Shape &shape);
+
+private:
+	void upload();
+
+	std::vector<Instance> instances;
+	unsigned bufferID;
+	size_t capacity; // instances the buffer has room for
+	bool dirty;
+};
+
+#endif // INSTANCEBATCH_H
@@ -0,0 +1,298 @@
+#include "LightClusters.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CLUSTERS_SSE
+#include <xmmintrin.h>
+#endif
+
+#include "GLSL.h"
+#include "GLState.h"
+
+using namespace std;
+using namespace glm;
+
+LightClusters::LightClusters() :
+	sliceScale(0),
+	sliceBias(0),
+	nearPlane(0),
+	farPlane(0),
+	textureSource(0),
+	blockID(0),
+	visibleLights(0),
+	maxPerCluster(0),
+	binTime(0)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		textures[i] = 0;
+	}
+}
+
+LightClusters::~LightClusters()
+{
+	if (blockID != 0)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			GLState::deleteTexture(textures[i]);
+		}
+		GLState::deleteBuffer(blockID);
+	}
+}
+
+void LightClusters::init()
+{
+	CHECKED_GL_CALL(glGenTextures(3, textures));
+
+	// zeroed, so shaders drawn before the first update() see no lights
+	Block block;
+	memset(&block, 0, sizeof(block));
+	CHECKED_GL_CALL(glGenBuffers(1, &blockID));
+	CHECKED_GL_CALL(GLState::bindBuffer(GL_UNIFORM_BUFFER, blockID));
+	CHECKED_GL_CALL(glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &block, GL_DYNAMIC_DRAW));
+	CHECKED_GL_CALL(GLState::bindBufferBase(GL_UNIFORM_BUFFER, GLSL::BINDING_LIGHTS, blockID));
+}
+
+void LightClusters::add(const vec3 &position, float radius, const vec3 &color)
+{
+	Light light;
+	light.position = position;
+	light.radius = radius;
+	light.color = color;
+	lights.push_back(light);
+}
+
+float LightClusters::getAveragePerCluster() const
+{
+	int occupied = 0;
+	for (int c = 0; c < NUM_CLUSTERS && !grid.empty(); c++)
+	{
+		occupied += grid[c * 2 + 1] != 0 ? 1 : 0;
+	}
+	return occupied == 0 ? 0.0f : indices.size() / (float)occupied;
+}
+
+// Plane k of n tiles sits at ndc -1 + 2k / n. In view space it goes through
+// the eye, clip.x - ndc * clip.w = 0 gives its normal in the x/z plane
+// (the y/z plane for rows), pointing towards the higher tiles.
+static void tilePlanes(int tiles, float scale, float offset, float w, float *pn, float *pz)
+{
+	for (int k = 0; k < tiles + 4; k++)
+	{
+		float ndc = -1.0f + 2.0f * (std::min)(k, tiles) / tiles;
+		float n = scale, z = offset - ndc * w;
+		float length = sqrt(n * n + z * z);
+		pn[k] = n / length;
+		pz[k] = z / length;
+	}
+}
+
+void LightClusters::buildPlanes(const mat4 &P)
+{
+	tilePlanes(GRID_X, P[0][0], P[2][0], P[2][3], planeX, planeXZ);
+	tilePlanes(GRID_Y, P[1][1], P[2][1], P[2][3], planeY, planeYZ);
+}
+
+static int countBits(int mask)
+{
+	int count = 0;
+	for (; mask != 0; mask &= mask - 1)
+	{
+		count++;
+	}
+	return count;
+}
+
+// Sphere (c, cz, r) in the plane of the normals against planes planes.
+// Bit k of reaching is set where part of the sphere is on the positive side
+// of plane k, bit k of beyond where all of it is.
+#ifdef CLUSTERS_SSE
+
+static void classify(const float *pn, const float *pz, int planes, float c, float cz, float r, int &reaching, int &beyond)
+{
+	__m128 vc = _mm_set1_ps(c), vz = _mm_set1_ps(cz);
+	__m128 vr = _mm_set1_ps(r), vnr = _mm_set1_ps(-r);
+	reaching = beyond = 0;
+	for (int k = 0; k < planes; k += 4)
+	{
+		__m128 s = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pn + k), vc), _mm_mul_ps(_mm_loadu_ps(pz + k), vz));
+		reaching |= _mm_movemask_ps(_mm_cmpgt_ps(s, vnr)) << k;
+		beyond |= _mm_movemask_ps(_mm_cmpge_ps(s, vr)) << k;
+	}
+}
+
+#else
+
+static void classify(const float *pn, const float *pz, int planes, float c, float cz, float r, int &reaching, int &beyond)
+{
+	reaching = beyond = 0;
+	for (int k = 0; k < planes; k++)
+	{
+		float s = pn[k] * c + pz[k] * cz;
+		reaching |= (s > -r ? 1 : 0) << k;
+		beyond |= (s >= r ? 1 : 0) << k;
+	}
+}
+
+#endif
+
+// Tiles first to last along one axis. The signed distance falls from plane
+// to plane, so the sphere starts after the planes it is entirely beyond and
+// ends at the last plane it reaches past.
+static void tileRange(const float *pn, const float *pz, int tiles, float c, float cz, float r, int &first, int &last)
+{
+	int reaching, beyond;
+	classify(pn, pz, tiles + 1, c, cz, r, reaching, beyond);
+	first = countBits(beyond & ((1 << (tiles + 1)) - 2));
+	last = countBits(reaching & ((1 << tiles) - 1)) - 1;
+}
+
+LightClusters::Range LightClusters::bin(const vec3 &center, float radius) const
+{
+	Range range = {0, -1, 0, -1, 0, -1};
+	float depth = -center.z;
+	if (depth + radius < nearPlane || depth - radius > farPlane)
+	{
+		return range;
+	}
+
+	float nearest = (std::max)(depth - radius, nearPlane);
+	float farthest = (std::min)(depth + radius, farPlane);
+	range.z0 = (std::max)((int)floor(log(nearest) * sliceScale + sliceBias), 0);
+	range.z1 = (std::min)((int)floor(log(farthest) * sliceScale + sliceBias), GRID_Z - 1);
+	tileRange(planeX, planeXZ, GRID_X, center.x, center.z, radius, range.x0, range.x1);
+	tileRange(planeY, planeYZ, GRID_Y, center.y, center.z, radius, range.y0, range.y1);
+	return range;
+}
+
+void LightClusters::update(const mat4 &P, const mat4 &V, float nearPlane, float farPlane)
+{
+	auto start = chrono::high_resolution_clock::now();
+
+	this->nearPlane = nearPlane;
+	this->farPlane = farPlane;
+	sliceScale = GRID_Z / log(farPlane / nearPlane);
+	sliceBias = -log(nearPlane) * sliceScale;
+	buildPlanes(P);
+
+	// count the lights of every cluster
+	ranges.resize(lights.size());
+	counts.assign(NUM_CLUSTERS, 0);
+	vector<int> visible;
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		Range &r = ranges[i];
+		r = bin(vec3(V * vec4(lights[i].position, 1)), lights[i].radius);
+		if (r.x0 > r.x1 || r.y0 > r.y1 || r.z0 > r.z1)
+		{
+			continue;
+		}
+		visible.push_back((int)i);
+		for (int z = r.z0; z <= r.z1; z++)
+		{
+			for (int y = r.y0; y <= r.y1; y++)
+			{
+				uint32_t *row = &counts[(z * GRID_Y + y) * GRID_X];
+				for (int x = r.x0; x <= r.x1; x++)
+				{
+					row[x]++;
+				}
+			}
+		}
+	}
+
+	// counts become the write cursors into the index lists
+	grid.resize(NUM_CLUSTERS * 2);
+	uint32_t offset = 0;
+	maxPerCluster = 0;
+	for (int c = 0; c < NUM_CLUSTERS; c++)
+	{
+		grid[c * 2] = offset;
+		grid[c * 2 + 1] = counts[c];
+		maxPerCluster = (std::max)(maxPerCluster, (int)counts[c]);
+		offset += counts[c];
+		counts[c] = grid[c * 2];
+	}
+
+	// lights are numbered by their slot in the uploaded array
+	indices.resize(offset);
+	for (size_t v = 0; v < visible.size(); v++)
+	{
+		const Range &r = ranges[visible[v]];
+		for (int z = r.z0; z <= r.z1; z++)
+		{
+			for (int y = r.y0; y <= r.y1; y++)
+			{
+				uint32_t *row = &counts[(z * GRID_Y + y) * GRID_X];
+				for (int x = r.x0; x <= r.x1; x++)
+				{
+					indices[row[x]++] = (uint32_t)v;
+				}
+			}
+		}
+	}
+	visibleLights = (int)visible.size();
+
+	upload(visible);
+
+	binTime = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+void LightClusters::upload(const vector<int> &visible)
+{
+	size_t lightBytes = visible.size() * 2 * sizeof(vec4);
+	size_t gridBytes = grid.size() * sizeof(uint32_t);
+	size_t indexBytes = indices.size() * sizeof(uint32_t);
+	size_t bytes = lightBytes + gridBytes + indexBytes;
+
+	char *data = (char *)stream.begin(bytes);
+	vec4 *out = (vec4 *)data;
+	for (size_t v = 0; v < visible.size(); v++)
+	{
+		const Light &light = lights[visible[v]];
+		out[v * 2] = vec4(light.position, light.radius);
+		out[v * 2 + 1] = vec4(light.color, 0);
+	}
+	memcpy(data + lightBytes, &grid[0], gridBytes);
+	if (indexBytes > 0)
+	{
+		memcpy(data + lightBytes + gridBytes, &indices[0], indexBytes);
+	}
+	size_t offset = stream.commit(bytes);
+
+	// three views of the same buffer, they follow it when it is reallocated
+	static const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+	static const int units[3] = {GLSL::UNIT_CLUSTER_LIGHTS, GLSL::UNIT_CLUSTER_GRID, GLSL::UNIT_CLUSTER_INDICES};
+	for (int i = 0; i < 3; i++)
+	{
+		GLState::activeTexture(GL_TEXTURE0 + units[i]);
+		GLState::bindTexture(GL_TEXTURE_BUFFER, textures[i]);
+		if (textureSource != stream.getBuffer())
+		{
+			glTexBuffer(GL_TEXTURE_BUFFER, formats[i], stream.getBuffer());
+		}
+	}
+	textureSource = stream.getBuffer();
+	GLState::activeTexture(GL_TEXTURE0);
+
+	// each array starts on a multiple of its own texel size
+	Block block;
+	block.grid[0] = GRID_X;
+	block.grid[1] = GRID_Y;
+	block.grid[2] = GRID_Z;
+	block.grid[3] = (int)visible.size();
+	block.slices[0] = sliceScale;
+	block.slices[1] = sliceBias;
+	block.slices[2] = nearPlane;
+	block.slices[3] = farPlane;
+	block.base[0] = (int)(offset / sizeof(vec4));
+	block.base[1] = (int)((offset + lightBytes) / (2 * sizeof(uint32_t)));
+	block.base[2] = (int)((offset + lightBytes + gridBytes) / sizeof(uint32_t));
+	block.base[3] = 0;
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, blockID);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+}
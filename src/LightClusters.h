@@ -0,0 +1,121 @@
+/*
+ * Clustered forward lighting.
+ *
+ * The view frustum is split into a GRID_X x GRID_Y x GRID_Z grid of
+ * clusters: screen tiles in x and y, slices in z that grow exponentially
+ * with depth so clusters stay roughly cube shaped. Every frame update()
+ * bins the point lights into the clusters on the CPU. A light's sphere is
+ * tested against all tile planes of the frustum at once with SSE, which
+ * gives the range of columns and rows it touches, and its depth range
+ * gives the slices. The light then goes into every cluster of that box.
+ *
+ * The result is three arrays written into one StreamBuffer region: the
+ * lights that touched a cluster (2 texels each: position and radius,
+ * color), one (offset, count) pair per cluster and the light index lists
+ * the pairs point into. The shaders read them through the clusterLights,
+ * clusterGrid and clusterIndices buffer textures and find the grid size,
+ * slice mapping and where each array starts in the "Lights" uniform block
+ *
+ *   layout(std140) uniform Lights
+ *   {
+ *       ivec4 lightGrid; // clusters in x, y, z, lights this frame
+ *       vec4 lightSlices; // slice = log(view depth) * x + y
+ *       ivec4 lightBase; // first texel of the lights, grid and index lists
+ *   };
+ *
+ * so a fragment only loops over the lights of its own cluster.
+ */
+
+#pragma once
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include <vector>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "StreamBuffer.h"
+
+class LightClusters
+{
+public:
+	static const int GRID_X = 16;
+	static const int GRID_Y = 9;
+	static const int GRID_Z = 24;
+	static const int NUM_CLUSTERS = GRID_X * GRID_Y * GRID_Z;
+
+	struct Light
+	{
+		glm::vec3 position; // world space
+		float radius; // no light past this distance
+		glm::vec3 color;
+	};
+
+	LightClusters();
+	~LightClusters();
+
+	// needs a GL context, call once before the first update()
+	void init();
+
+	void clear() { lights.clear(); }
+	void add(const glm::vec3 &position, float radius, const glm::vec3 &color);
+	int size() const { return (int)lights.size(); }
+
+	// bins the lights for this frame's camera and uploads the result, call
+	// every frame before the draws, also without lights
+	void update(const glm::mat4 &P, const glm::mat4 &V, float nearPlane, float farPlane);
+	// call after the draws that read the clusters
+	void fence() { stream.fence(); }
+
+	// stats of the last update()
+	int getVisibleLights() const { return visibleLights; }
+	int getIndexCount() const { return (int)indices.size(); }
+	int getMaxPerCluster() const { return maxPerCluster; }
+	float getAveragePerCluster() const; // over the clusters with any light
+	float getBinTime() const { return binTime; } // milliseconds, binning and upload
+
+private:
+	// must match the std140 layout above
+	struct Block
+	{
+		GLint grid[4];
+		GLfloat slices[4];
+		GLint base[4];
+	};
+
+	// inclusive cluster ranges of a light, empty when x0 > x1
+	struct Range
+	{
+		int x0, x1, y0, y1, z0, z1;
+	};
+
+	void buildPlanes(const glm::mat4 &P);
+	Range bin(const glm::vec3 &center, float radius) const;
+	void upload(const std::vector<int> &visible);
+
+	std::vector<Light> lights;
+
+	// the tile planes through the eye as (n.x or n.y, n.z), normalized and
+	// padded for the last 4-wide load, rebuilt every update()
+	float planeX[GRID_X + 4], planeXZ[GRID_X + 4];
+	float planeY[GRID_Y + 4], planeYZ[GRID_Y + 4];
+	float sliceScale, sliceBias; // slice = log(depth) * sliceScale + sliceBias
+	float nearPlane, farPlane;
+
+	std::vector<Range> ranges; // per light
+	std::vector<uint32_t> counts; // per cluster, then the running offsets
+	std::vector<uint32_t> grid; // (offset, count) per cluster
+	std::vector<uint32_t> indices;
+
+	StreamBuffer stream;
+	GLuint textures[3]; // lights, grid, index lists, all views of the stream
+	GLuint textureSource; // buffer the textures were last attached to
+	GLuint blockID;
+
+	int visibleLights;
+	int maxPerCluster;
+	float binTime;
+};
+
+#endif // LIGHTCLUSTERS_H
@@ -0,0 +1,155 @@
+#include "MeshBVH.h"
+
+#include <cmath>
+
+using namespace std;
+using namespace glm;
+
+MeshBVH::MeshBVH(const vector<float> &positions, const vector<unsigned int> &indices)
+{
+	int numTris = (int)(indices.size() / 3);
+	vector<vec3> mins(numTris);
+	vector<vec3> maxs(numTris);
+	vector<vec3> verts(indices.size());
+	for (int i = 0; i < numTris * 3; i++)
+	{
+		unsigned int v = indices[i];
+		verts[i] = vec3(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+	}
+	for (int i = 0; i < numTris; i++)
+	{
+		mins[i] = glm::min(verts[i * 3], glm::min(verts[i * 3 + 1], verts[i * 3 + 2]));
+		maxs[i] = glm::max(verts[i * 3], glm::max(verts[i * 3 + 1], verts[i * 3 + 2]));
+	}
+	tree.build(mins, maxs, 4);
+
+	// store the triangles in leaf order so a leaf reads one contiguous block
+	tris.resize(verts.size());
+	triIndex.resize(numTris);
+	for (int i = 0; i < numTris; i++)
+	{
+		int src = tree.items[i];
+		triIndex[i] = src;
+		tris[i * 3] = verts[src * 3];
+		tris[i * 3 + 1] = verts[src * 3 + 1];
+		tris[i * 3 + 2] = verts[src * 3 + 2];
+	}
+}
+
+bool MeshBVH::intersectTriangle(const vec3 &origin, const vec3 &dir,
+	const vec3 &v0, const vec3 &v1, const vec3 &v2, float &t, vec2 &bary)
+{
+	vec3 e1 = v1 - v0;
+	vec3 e2 = v2 - v0;
+	vec3 p = cross(dir, e2);
+	float det = dot(e1, p);
+	if (fabs(det) < 1e-12f)
+	{
+		return false;
+	}
+	float inv = 1.0f / det;
+	vec3 s = origin - v0;
+	float u = dot(s, p) * inv;
+	if (u < 0 || u > 1)
+	{
+		return false;
+	}
+	vec3 q = cross(s, e1);
+	float v = dot(dir, q) * inv;
+	if (v < 0 || u + v > 1)
+	{
+		return false;
+	}
+	t = dot(e2, q) * inv;
+	bary = vec2(u, v);
+	return true;
+}
+
+template <bool anyHit>
+bool MeshBVH::traverse(const vec3 &origin, const vec3 &dir, float maxT, RayHit &hit) const
+{
+	if (tree.empty())
+	{
+		return false;
+	}
+
+	vec3 invDir = 1.0f / dir;
+	bool found = false;
+	float best = maxT;
+
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const BoundsNode &node = tree.nodes[stack[--top]];
+		float tEnter;
+		if (!BoundsTree::intersectRay(origin, invDir, node.min, node.max, best, tEnter))
+		{
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				float t;
+				vec2 bary;
+				if (intersectTriangle(origin, dir, tris[i * 3], tris[i * 3 + 1], tris[i * 3 + 2], t, bary) &&
+					t >= 0 && t <= best)
+				{
+					best = t;
+					hit.t = t;
+					hit.triangle = triIndex[i];
+					hit.bary = bary;
+					found = true;
+					if (anyHit)
+					{
+						return true;
+					}
+				}
+			}
+			continue;
+		}
+
+		// visit the nearer child first so the far one is usually culled by `best`
+		const BoundsNode &left = tree.nodes[node.first];
+		const BoundsNode &right = tree.nodes[node.first + 1];
+		float tl, tr;
+		bool hl = BoundsTree::intersectRay(origin, invDir, left.min, left.max, best, tl);
+		bool hr = BoundsTree::intersectRay(origin, invDir, right.min, right.max, best, tr);
+		if (hl && hr)
+		{
+			if (tl <= tr)
+			{
+				stack[top++] = node.first + 1;
+				stack[top++] = node.first;
+			}
+			else
+			{
+				stack[top++] = node.first;
+				stack[top++] = node.first + 1;
+			}
+		}
+		else if (hl)
+		{
+			stack[top++] = node.first;
+		}
+		else if (hr)
+		{
+			stack[top++] = node.first + 1;
+		}
+	}
+	return found;
+}
+
+bool MeshBVH::intersect(const vec3 &origin, const vec3 &dir, float maxT, RayHit &hit) const
+{
+	return traverse<false>(origin, dir, maxT, hit);
+}
+
+bool MeshBVH::occluded(const vec3 &origin, const vec3 &dir, float maxT) const
+{
+	RayHit hit;
+	return traverse<true>(origin, dir, maxT, hit);
+}
@@ -0,0 +1,50 @@
+/*
+ * Triangle bounding volume hierarchy for a single Shape, in the Shape's
+ * local space. Used for ray picking and any other ray casts against meshes.
+ * Built on demand with Shape::getBVH().
+ */
+
+#pragma once
+#ifndef MESHBVH_H
+#define MESHBVH_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "BoundsTree.h"
+
+struct RayHit
+{
+	float t; // distance along the ray, in units of the ray direction
+	int triangle;
+	glm::vec2 bary; // barycentrics of vertices 1 and 2, vertex 0 is 1 - u - v
+};
+
+class MeshBVH
+{
+public:
+	MeshBVH(const std::vector<float> &positions, const std::vector<unsigned int> &indices);
+
+	// closest hit along origin + t * dir for t in [0, maxT]
+	bool intersect(const glm::vec3 &origin, const glm::vec3 &dir, float maxT, RayHit &hit) const;
+
+	// true if anything is hit in [0, maxT], stops at the first hit (shadow/occlusion rays)
+	bool occluded(const glm::vec3 &origin, const glm::vec3 &dir, float maxT) const;
+
+	int getNumTriangles() const { return (int)(tris.size() / 3); }
+	const BoundsTree &getTree() const { return tree; }
+
+	// Moller-Trumbore, culls nothing
+	static bool intersectTriangle(const glm::vec3 &origin, const glm::vec3 &dir,
+		const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2, float &t, glm::vec2 &bary);
+
+private:
+	template <bool anyHit>
+	bool traverse(const glm::vec3 &origin, const glm::vec3 &dir, float maxT, RayHit &hit) const;
+
+	std::vector<glm::vec3> tris; // 3 vertices per triangle, in tree item order
+	std::vector<int> triIndex; // original triangle index of each entry in tris
+	BoundsTree tree;
+};
+
+#endif // MESHBVH_H
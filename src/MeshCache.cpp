@@ -0,0 +1,256 @@
+#include "MeshCache.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <set>
+
+#include <tiny_obj_loader/tiny_obj_loader.h>
+
+#include "WorkerPool.h"
+
+using namespace std;
+
+shared_ptr<Shape> MeshAsset::part(const shared_ptr<MeshAsset> &asset, size_t i)
+{
+	// aliasing constructor: shares the asset's reference count
+	return shared_ptr<Shape>(asset, asset->parts[i].get());
+}
+
+size_t MeshAsset::getMemory() const
+{
+	size_t bytes = 0;
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		bytes += parts[i]->getCPUMemory() + parts[i]->getGPUMemory();
+	}
+	return bytes;
+}
+
+MeshCache::MeshCache() :
+	hits(0),
+	misses(0),
+	savedBytes(0)
+{
+}
+
+MeshCache &MeshCache::shared()
+{
+	static MeshCache cache;
+	return cache;
+}
+
+uint64_t MeshCache::hashBytes(const string &bytes)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < bytes.size(); i++)
+	{
+		hash ^= (unsigned char)bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+void MeshCache::prune()
+{
+	for (map<string, weak_ptr<MeshAsset>>::iterator it = byPath.begin(); it != byPath.end();)
+	{
+		it = it->second.expired() ? byPath.erase(it) : ++it;
+	}
+	for (map<uint64_t, weak_ptr<MeshAsset>>::iterator it = byHash.begin(); it != byHash.end();)
+	{
+		it = it->second.expired() ? byHash.erase(it) : ++it;
+	}
+}
+
+// over byPath, which holds generated primitives too, several paths can share an asset
+size_t MeshCache::getNumAssets() const
+{
+	set<const MeshAsset *> alive;
+	for (map<string, weak_ptr<MeshAsset>>::const_iterator it = byPath.begin(); it != byPath.end(); ++it)
+	{
+		shared_ptr<MeshAsset> asset = it->second.lock();
+		if (asset != nullptr)
+		{
+			alive.insert(asset.get());
+		}
+	}
+	return alive.size();
+}
+
+shared_ptr<MeshAsset> MeshCache::load(const string &path)
+{
+	return load(vector<string>(1, path))[0];
+}
+
+shared_ptr<MeshAsset> MeshCache::parse(const string &path, bool &cached)
+{
+	cached = false;
+	ifstream file(path, ios::binary);
+	if (!file.is_open())
+	{
+		cerr << "Could not open file: '" << path << "'" << endl;
+		return nullptr;
+	}
+	string bytes((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+	uint64_t hash = hashBytes(bytes);
+
+	// same path with unchanged contents, or the same contents under another name
+	shared_ptr<MeshAsset> asset = byPath[path].lock();
+	if (asset == nullptr || asset->hash != hash)
+	{
+		asset = byHash[hash].lock();
+	}
+	if (asset != nullptr)
+	{
+		byPath[path] = asset;
+		hits++;
+		cached = true;
+		return asset;
+	}
+
+	// parse from the bytes already in memory, materials relative to the file
+	vector<tinyobj::shape_t> shapes;
+	vector<tinyobj::material_t> materials;
+	string errStr;
+	size_t slash = path.find_last_of("/\\");
+	tinyobj::MaterialFileReader matReader(slash == string::npos ? "" : path.substr(0, slash + 1));
+	istringstream stream(bytes);
+	if (!tinyobj::LoadObj(shapes, materials, errStr, stream, matReader))
+	{
+		cerr << errStr << endl;
+		return nullptr;
+	}
+
+	asset = make_shared<MeshAsset>();
+	asset->path = path;
+	asset->hash = hash;
+	for (size_t i = 0; i < shapes.size(); i++)
+	{
+		Shape *s = new Shape();
+		asset->parts.push_back(unique_ptr<Shape>(s));
+		s->createShape(shapes[i]);
+		s->measure();
+	}
+	// registered right away, so a copy later in the same batch is a hit
+	misses++;
+	byPath[path] = asset;
+	byHash[hash] = asset;
+	return asset;
+}
+
+vector<shared_ptr<MeshAsset>> MeshCache::load(const vector<string> &paths)
+{
+	prune();
+
+	vector<shared_ptr<MeshAsset>> assets(paths.size());
+	vector<bool> cached(paths.size());
+	vector<Shape *> parts;
+	for (size_t p = 0; p < paths.size(); p++)
+	{
+		bool hit;
+		assets[p] = parse(paths[p], hit);
+		cached[p] = hit;
+		if (assets[p] != nullptr && !hit)
+		{
+			for (size_t i = 0; i < assets[p]->parts.size(); i++)
+			{
+				parts.push_back(assets[p]->parts[i].get());
+			}
+		}
+	}
+
+	// reordering, the LOD chains, meshlets and the picking BVH are CPU
+	// only, the uploads stay on this thread
+	vector<MeshOptimizer::CacheStats> before(parts.size()), after(parts.size());
+	WorkerPool::shared().parallelFor((int)parts.size(), 1, [&](int begin, int end) {
+		for (int i = begin; i < end; i++)
+		{
+			parts[i]->optimize(before[i], after[i]);
+			parts[i]->buildLODs();
+			parts[i]->buildMeshlets();
+			// built here rather than inside the first click on the mesh, after
+			// the meshlets have settled the triangle order
+			parts[i]->getBVH();
+		}
+	});
+	// AO needs the final vertex order, each bake spreads over the pool itself
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		cacheBefore.add(before[i]);
+		cacheAfter.add(after[i]);
+		parts[i]->bakeAO(bakeCacheDir);
+		parts[i]->init();
+	}
+	// a hit on an asset earlier in this batch only has its GPU size now
+	for (size_t p = 0; p < paths.size(); p++)
+	{
+		if (cached[p])
+		{
+			savedBytes += assets[p]->getMemory();
+		}
+	}
+	return assets;
+}
+
+bool MeshCache::loadParts(const string &path, vector<shared_ptr<Shape>> &parts)
+{
+	shared_ptr<MeshAsset> asset = load(path);
+	if (asset == nullptr)
+	{
+		return false;
+	}
+	appendParts(asset, parts);
+	return true;
+}
+
+void MeshCache::appendParts(const shared_ptr<MeshAsset> &asset, vector<shared_ptr<Shape>> &parts)
+{
+	for (size_t i = 0; asset != nullptr && i < asset->parts.size(); i++)
+	{
+		parts.push_back(MeshAsset::part(asset, i));
+	}
+}
+
+shared_ptr<Shape> MeshCache::loadPrimitive(Primitives::Type type, int detail)
+{
+	prune();
+
+	if (detail < 0)
+	{
+		detail = Primitives::getDefaultDetail(type);
+	}
+	ostringstream name;
+	name << "<" << Primitives::getName(type) << " " << detail << ">";
+	string path = name.str();
+
+	shared_ptr<MeshAsset> asset = byPath[path].lock();
+	if (asset != nullptr)
+	{
+		hits++;
+		savedBytes += asset->getMemory();
+		return MeshAsset::part(asset, 0);
+	}
+
+	tinyobj::shape_t mesh;
+	vector<vector<unsigned int>> lods;
+	Primitives::generate(type, detail, mesh, lods);
+
+	asset = make_shared<MeshAsset>();
+	asset->path = path;
+	asset->hash = hashBytes(path);
+	Shape *s = new Shape();
+	asset->parts.push_back(unique_ptr<Shape>(s));
+	// generated in vertex cache friendly strips, optimize() would reorder the
+	// vertices under the LOD index lists
+	s->createShape(mesh);
+	s->setLODs(lods);
+	s->measure();
+	s->buildMeshlets();
+	s->getBVH();
+	s->init();
+	misses++;
+	byPath[path] = asset;
+	return MeshAsset::part(asset, 0);
+}
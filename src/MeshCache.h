@@ -0,0 +1,87 @@
+/*
+ * Mesh asset registry.
+ *
+ * load() reads a file, hashes its bytes and returns the already loaded asset
+ * when the same path or the same content was loaded before, so each distinct
+ * mesh is parsed and uploaded to the GPU once. The registry itself only keeps
+ * weak references: an asset (and its GL buffers) is released as soon as the
+ * last handle to it or to one of its parts goes away.
+ *
+ * Generated primitives go through the same registry, under a name like
+ * "<sphere 16>" in place of a path.
+ */
+
+#pragma once
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstdint>
+
+#include "Shape.h"
+#include "Primitives.h"
+
+struct MeshAsset
+{
+	std::string path;
+	uint64_t hash; // FNV-1a of the file contents
+	std::vector<std::unique_ptr<Shape>> parts;
+
+	// handle to one part that keeps the whole asset alive
+	static std::shared_ptr<Shape> part(const std::shared_ptr<MeshAsset> &asset, size_t i);
+
+	size_t getMemory() const; // CPU + GPU bytes of all parts
+};
+
+class MeshCache
+{
+public:
+	static MeshCache &shared();
+
+	// nullptr if the file can't be read or parsed
+	std::shared_ptr<MeshAsset> load(const std::string &path);
+	// Several files as one batch: the reordering, LOD chains and BVHs of all
+	// their parts are spread over the worker pool together, so single part
+	// meshes build in parallel with each other too. One entry per path.
+	std::vector<std::shared_ptr<MeshAsset>> load(const std::vector<std::string> &paths);
+
+	// loads and appends a handle per part, like the old loadMultiPartObject
+	bool loadParts(const std::string &path, std::vector<std::shared_ptr<Shape>> &parts);
+	static void appendParts(const std::shared_ptr<MeshAsset> &asset, std::vector<std::shared_ptr<Shape>> &parts);
+
+	// Generated primitive with its LOD levels, shared like a loaded file.
+	// A detail below 0 picks Primitives::getDefaultDetail.
+	std::shared_ptr<Shape> loadPrimitive(Primitives::Type type, int detail = -1);
+
+	// where Shape::bakeAO caches its results, empty (the default) for no cache
+	void setBakeCacheDirectory(const std::string &directory) { bakeCacheDir = directory; }
+
+	int getHits() const { return hits; }
+	int getMisses() const { return misses; }
+	size_t getSavedBytes() const { return savedBytes; } // memory duplicate loads would have used
+	size_t getNumAssets() const; // assets still alive
+	// vertex cache statistics of every mesh loaded, before and after Shape::optimize()
+	const MeshOptimizer::CacheStats &getCacheBefore() const { return cacheBefore; }
+	const MeshOptimizer::CacheStats &getCacheAfter() const { return cacheAfter; }
+
+private:
+	MeshCache();
+	void prune();
+	// reads and parses a file into an asset with measured but unprocessed parts
+	std::shared_ptr<MeshAsset> parse(const std::string &path, bool &cached);
+	static uint64_t hashBytes(const std::string &bytes);
+
+	std::map<std::string, std::weak_ptr<MeshAsset>> byPath;
+	std::map<uint64_t, std::weak_ptr<MeshAsset>> byHash;
+	std::string bakeCacheDir;
+	int hits;
+	int misses;
+	size_t savedBytes;
+	MeshOptimizer::CacheStats cacheBefore;
+	MeshOptimizer::CacheStats cacheAfter;
+};
+
+#endif // MESHCACHE_H
@@ -0,0 +1,327 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+// Forsyth's scoring, see "Linear-Speed Vertex Cache Optimisation"
+static const int SCORE_CACHE_SIZE = 32;
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+static float vertexScore(int cachePosition, int remaining)
+{
+	if (remaining == 0)
+	{
+		return -1;
+	}
+	float score = 0;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+		{
+			// the last triangle's vertices, using them again barely helps the strip
+			score = LAST_TRIANGLE_SCORE;
+		}
+		else
+		{
+			float scale = 1.0f / (SCORE_CACHE_SIZE - 3);
+			score = pow(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+		}
+	}
+	// vertices with few triangles left should be finished off
+	return score + VALENCE_BOOST_SCALE * pow((float)remaining, -VALENCE_BOOST_POWER);
+}
+
+static vec3 position(const vector<float> &positions, unsigned int v)
+{
+	return vec3(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+}
+
+namespace MeshOptimizer
+{
+
+CacheStats simulateCache(const vector<unsigned int> &indices, int first, int count, int cacheSize)
+{
+	CacheStats stats;
+	stats.triangles = count / 3;
+
+	// FIFO: a hit doesn't move the vertex, timestamps tell what is still in
+	vector<unsigned int> seen;
+	vector<long long> insertedAt;
+	long long time = 0;
+	unsigned int maxIndex = 0;
+	for (int i = first; i < first + count; i++)
+	{
+		maxIndex = (std::max)(maxIndex, indices[i]);
+	}
+	insertedAt.assign(maxIndex + 1, -1);
+	for (int i = first; i < first + count; i++)
+	{
+		long long &inserted = insertedAt[indices[i]];
+		if (inserted < 0)
+		{
+			stats.vertices++;
+		}
+		if (inserted < 0 || time - inserted >= cacheSize)
+		{
+			inserted = time++;
+			stats.misses++;
+		}
+	}
+	return stats;
+}
+
+void optimizeVertexCache(vector<unsigned int> &indices, int first, int count, int numVertices)
+{
+	int numTris = count / 3;
+	if (numTris < 2)
+	{
+		return;
+	}
+	const unsigned int *tris = &indices[first];
+
+	// triangles around each vertex
+	vector<int> offsets(numVertices + 1, 0);
+	for (int i = 0; i < numTris * 3; i++)
+	{
+		offsets[tris[i] + 1]++;
+	}
+	for (int v = 0; v < numVertices; v++)
+	{
+		offsets[v + 1] += offsets[v];
+	}
+	vector<int> adjacency(numTris * 3);
+	vector<int> fill(offsets.begin(), offsets.end() - 1);
+	for (int t = 0; t < numTris; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			adjacency[fill[tris[t * 3 + k]]++] = t;
+		}
+	}
+
+	vector<int> remaining(numVertices);
+	vector<int> cachePosition(numVertices, -1);
+	vector<float> score(numVertices);
+	for (int v = 0; v < numVertices; v++)
+	{
+		remaining[v] = offsets[v + 1] - offsets[v];
+		score[v] = vertexScore(-1, remaining[v]);
+	}
+	vector<float> triScore(numTris);
+	vector<bool> emitted(numTris, false);
+	for (int t = 0; t < numTris; t++)
+	{
+		triScore[t] = score[tris[t * 3]] + score[tris[t * 3 + 1]] + score[tris[t * 3 + 2]];
+	}
+
+	vector<unsigned int> output;
+	output.reserve(numTris * 3);
+	vector<unsigned int> cache, nextCache;
+	int best = (int)(std::max_element(triScore.begin(), triScore.end()) - triScore.begin());
+	int scan = 0; // everything before it is emitted
+	while (best >= 0)
+	{
+		emitted[best] = true;
+		nextCache.clear();
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = tris[best * 3 + k];
+			output.push_back(v);
+			nextCache.push_back(v);
+
+			// take the triangle out of the vertex's list
+			int end = offsets[v] + remaining[v];
+			for (int a = offsets[v]; a < end; a++)
+			{
+				if (adjacency[a] == best)
+				{
+					std::swap(adjacency[a], adjacency[end - 1]);
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+		// LRU: the new triangle's vertices in front, the rest shifted back
+		for (size_t c = 0; c < cache.size(); c++)
+		{
+			unsigned int v = cache[c];
+			if (v != nextCache[0] && v != nextCache[1] && v != nextCache[2])
+			{
+				nextCache.push_back(v);
+			}
+		}
+		cache.swap(nextCache);
+
+		// rescore what is in the cache (and what just fell out), and look
+		// for the next triangle among their triangles
+		best = -1;
+		float bestScore = -1;
+		for (size_t c = 0; c < cache.size(); c++)
+		{
+			unsigned int v = cache[c];
+			int position = c < (size_t)SCORE_CACHE_SIZE ? (int)c : -1;
+			cachePosition[v] = position;
+			float newScore = vertexScore(position, remaining[v]);
+			float delta = newScore - score[v];
+			score[v] = newScore;
+			for (int a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+			{
+				int t = adjacency[a];
+				triScore[t] += delta;
+				if (triScore[t] > bestScore)
+				{
+					bestScore = triScore[t];
+					best = t;
+				}
+			}
+		}
+		if (cache.size() > (size_t)SCORE_CACHE_SIZE)
+		{
+			cache.resize(SCORE_CACHE_SIZE);
+		}
+
+		// nothing connected is left, start over at the best remaining triangle
+		if (best < 0)
+		{
+			while (scan < numTris && emitted[scan])
+			{
+				scan++;
+			}
+			for (int t = scan; t < numTris; t++)
+			{
+				if (!emitted[t] && triScore[t] > bestScore)
+				{
+					bestScore = triScore[t];
+					best = t;
+				}
+			}
+		}
+	}
+	std::copy(output.begin(), output.end(), indices.begin() + first);
+}
+
+void optimizeOverdraw(const vector<float> &positions, vector<unsigned int> &indices, int first, int count)
+{
+	int numTris = count / 3;
+	if (numTris < 2)
+	{
+		return;
+	}
+
+	// split the cache friendly order into runs wherever a triangle misses
+	// completely, so moving a run around costs little cache efficiency
+	struct Cluster
+	{
+		int first; // triangle
+		int count;
+		float key;
+	};
+	vector<Cluster> clusters;
+	vector<unsigned int> fifo(16, ~0u);
+	int head = 0;
+	for (int t = 0; t < numTris; t++)
+	{
+		int misses = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = indices[first + t * 3 + k];
+			if (std::find(fifo.begin(), fifo.end(), v) == fifo.end())
+			{
+				fifo[head] = v;
+				head = (head + 1) % (int)fifo.size();
+				misses++;
+			}
+		}
+		if (clusters.empty() || (misses == 3 && clusters.back().count >= 16))
+		{
+			clusters.push_back({t, 0, 0});
+		}
+		clusters.back().count++;
+	}
+
+	vec3 center = vec3(0);
+	int numVerts = (int)positions.size() / 3;
+	for (int v = 0; v < numVerts; v++)
+	{
+		center += position(positions, v);
+	}
+	center /= (float)(std::max)(numVerts, 1);
+
+	// runs far out along their own normal are likely in front of the rest
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		vec3 normal = vec3(0);
+		vec3 centroid = vec3(0);
+		float area = 0;
+		for (int t = clusters[c].first; t < clusters[c].first + clusters[c].count; t++)
+		{
+			vec3 p0 = position(positions, indices[first + t * 3]);
+			vec3 p1 = position(positions, indices[first + t * 3 + 1]);
+			vec3 p2 = position(positions, indices[first + t * 3 + 2]);
+			vec3 n = cross(p1 - p0, p2 - p0);
+			float a = length(n);
+			normal += n;
+			centroid += (p0 + p1 + p2) * (a / 3.0f);
+			area += a;
+		}
+		centroid = area > 0 ? centroid / area : centroid;
+		clusters[c].key = length(normal) > 0 ? dot(centroid - center, normalize(normal)) : 0;
+	}
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const Cluster &a, const Cluster &b) { return a.key > b.key; });
+
+	vector<unsigned int> output;
+	output.reserve(numTris * 3);
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		output.insert(output.end(), indices.begin() + first + clusters[c].first * 3,
+			indices.begin() + first + (clusters[c].first + clusters[c].count) * 3);
+	}
+	std::copy(output.begin(), output.end(), indices.begin() + first);
+}
+
+void optimizeVertexFetch(vector<unsigned int> &indices, int numVertices, vector<unsigned int> &remap)
+{
+	const unsigned int UNUSED = ~0u;
+	remap.assign(numVertices, UNUSED);
+	unsigned int next = 0;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		unsigned int &target = remap[indices[i]];
+		if (target == UNUSED)
+		{
+			target = next++;
+		}
+		indices[i] = target;
+	}
+	for (int v = 0; v < numVertices; v++)
+	{
+		if (remap[v] == UNUSED)
+		{
+			remap[v] = next++;
+		}
+	}
+}
+
+void remapVertices(vector<float> &data, int components, const vector<unsigned int> &remap)
+{
+	if (data.size() < remap.size() * components)
+	{
+		return;
+	}
+	vector<float> out(data.size());
+	for (size_t v = 0; v < remap.size(); v++)
+	{
+		std::copy(data.begin() + v * components, data.begin() + (v + 1) * components, out.begin() + remap[v] * components);
+	}
+	data.swap(out);
+}
+
+}
@@ -0,0 +1,47 @@
+/*
+ * Load time reordering of a mesh for the GPU's vertex caches.
+ *
+ * optimizeVertexCache() reorders triangles with Tom Forsyth's linear-speed
+ * vertex cache algorithm. optimizeOverdraw() then optionally moves whole
+ * runs of that order so triangles facing outwards from the mesh center are
+ * drawn first. optimizeVertexFetch() renumbers vertices in the order the
+ * index buffer first uses them, so vertex fetches walk memory forwards.
+ *
+ * simulateCache() runs the indices through a FIFO post-transform cache.
+ * That gives ACMR (misses per triangle, 0.5 at best on large meshes, 3 at
+ * worst) and ATVR (misses per vertex, 1 at best), with no GPU needed.
+ */
+
+#pragma once
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <vector>
+
+namespace MeshOptimizer
+{
+	struct CacheStats
+	{
+		long long triangles;
+		long long vertices; // distinct vertices referenced
+		long long misses;
+
+		CacheStats() : triangles(0), vertices(0), misses(0) {}
+		float acmr() const { return triangles > 0 ? (float)misses / triangles : 0; }
+		float atvr() const { return vertices > 0 ? (float)misses / vertices : 0; }
+		void add(const CacheStats &s) { triangles += s.triangles; vertices += s.vertices; misses += s.misses; }
+	};
+
+	CacheStats simulateCache(const std::vector<unsigned int> &indices, int first, int count, int cacheSize = 16);
+
+	// triangles of indices[first, first + count)
+	void optimizeVertexCache(std::vector<unsigned int> &indices, int first, int count, int numVertices);
+	void optimizeOverdraw(const std::vector<float> &positions, std::vector<unsigned int> &indices, int first, int count);
+
+	// Renumbers the vertices of the whole index buffer in order of first use
+	// (unused vertices go last). remap[old] = new, apply it to every vertex array.
+	void optimizeVertexFetch(std::vector<unsigned int> &indices, int numVertices, std::vector<unsigned int> &remap);
+	void remapVertices(std::vector<float> &data, int components, const std::vector<unsigned int> &remap);
+}
+
+#endif // MESHOPTIMIZER_H
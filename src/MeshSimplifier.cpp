@@ -0,0 +1,240 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+// a collapse may turn a triangle's normal by at most this much (cosine)
+static const float MAX_FLIP_COS = 0.2f;
+
+// the quadric of a set of planes, as the upper triangle of a symmetric 4x4
+struct Quadric
+{
+	double a[10];
+
+	Quadric()
+	{
+		std::fill(a, a + 10, 0.0);
+	}
+
+	// plane n.p + d = 0, weighted by the triangle's area
+	void addPlane(const dvec3 &n, double d, double w)
+	{
+		a[0] += w * n.x * n.x; a[1] += w * n.x * n.y; a[2] += w * n.x * n.z; a[3] += w * n.x * d;
+		a[4] += w * n.y * n.y; a[5] += w * n.y * n.z; a[6] += w * n.y * d;
+		a[7] += w * n.z * n.z; a[8] += w * n.z * d;
+		a[9] += w * d * d;
+	}
+
+	void add(const Quadric &q)
+	{
+		for (int i = 0; i < 10; i++)
+		{
+			a[i] += q.a[i];
+		}
+	}
+
+	// sum of squared distances from p to the planes
+	double error(const dvec3 &p) const
+	{
+		return a[0] * p.x * p.x + 2 * a[1] * p.x * p.y + 2 * a[2] * p.x * p.z + 2 * a[3] * p.x
+			+ a[4] * p.y * p.y + 2 * a[5] * p.y * p.z + 2 * a[6] * p.y
+			+ a[7] * p.z * p.z + 2 * a[8] * p.z
+			+ a[9];
+	}
+};
+
+struct Collapse
+{
+	unsigned int from;
+	unsigned int to;
+	double cost;
+};
+
+static vec3 position(const vector<float> &positions, unsigned int v)
+{
+	return vec3(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+}
+
+static uint64_t edgeKey(unsigned int a, unsigned int b)
+{
+	return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+namespace MeshSimplifier
+{
+
+int simplify(const vector<float> &positions, const vector<unsigned int> &indices,
+	int targetTriangles, vector<unsigned int> &out)
+{
+	int numVerts = (int)positions.size() / 3;
+	out.assign(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+
+	// border edges belong to a single triangle
+	unordered_map<uint64_t, int> edgeUse;
+	for (size_t i = 0; i < out.size(); i += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			edgeUse[edgeKey(out[i + k], out[i + (k + 1) % 3])]++;
+		}
+	}
+	vector<bool> locked(numVerts, false);
+	for (auto it = edgeUse.begin(); it != edgeUse.end(); ++it)
+	{
+		if (it->second == 1)
+		{
+			locked[it->first >> 32] = true;
+			locked[it->first & 0xffffffffu] = true;
+		}
+	}
+
+	vector<Quadric> quadrics(numVerts);
+	for (size_t i = 0; i < out.size(); i += 3)
+	{
+		dvec3 p0 = dvec3(position(positions, out[i]));
+		dvec3 n = cross(dvec3(position(positions, out[i + 1])) - p0, dvec3(position(positions, out[i + 2])) - p0);
+		double area = length(n);
+		if (area <= 0)
+		{
+			continue;
+		}
+		n /= area;
+		for (int k = 0; k < 3; k++)
+		{
+			quadrics[out[i + k]].addPlane(n, -dot(n, p0), area);
+		}
+	}
+
+	// Collapses happen in passes over independent edges: a vertex whose
+	// triangles changed this pass isn't touched again until the next one
+	vector<int> offsets(numVerts + 1);
+	vector<int> adjacency;
+	vector<unsigned int> remap(numVerts);
+	vector<bool> touched(numVerts);
+	vector<Collapse> collapses;
+	int triangles = (int)out.size() / 3;
+	while (triangles > targetTriangles)
+	{
+		// triangles around each vertex
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (size_t i = 0; i < out.size(); i++)
+		{
+			offsets[out[i] + 1]++;
+		}
+		for (int v = 0; v < numVerts; v++)
+		{
+			offsets[v + 1] += offsets[v];
+		}
+		adjacency.resize(out.size());
+		vector<int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < out.size(); i++)
+		{
+			adjacency[fill[out[i]]++] = (int)(i / 3);
+		}
+
+		collapses.clear();
+		for (size_t i = 0; i < out.size(); i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int a = out[i + k];
+				unsigned int b = out[i + (k + 1) % 3];
+				Quadric q = quadrics[a];
+				q.add(quadrics[b]);
+				if (!locked[a])
+				{
+					collapses.push_back({a, b, q.error(dvec3(position(positions, b)))});
+				}
+				if (!locked[b])
+				{
+					collapses.push_back({b, a, q.error(dvec3(position(positions, a)))});
+				}
+			}
+		}
+		if (collapses.empty())
+		{
+			break;
+		}
+		std::sort(collapses.begin(), collapses.end(),
+			[](const Collapse &x, const Collapse &y) { return x.cost < y.cost; });
+
+		// each collapse removes about two triangles
+		int wanted = (triangles - targetTriangles + 1) / 2;
+		int done = 0;
+		std::fill(touched.begin(), touched.end(), false);
+		for (int v = 0; v < numVerts; v++)
+		{
+			remap[v] = v;
+		}
+		for (size_t c = 0; c < collapses.size() && done < wanted; c++)
+		{
+			const Collapse &collapse = collapses[c];
+			if (touched[collapse.from] || touched[collapse.to])
+			{
+				continue;
+			}
+
+			// reject collapses that fold a triangle over
+			vec3 target = position(positions, collapse.to);
+			bool flips = false;
+			for (int a = offsets[collapse.from]; a < offsets[collapse.from + 1] && !flips; a++)
+			{
+				const unsigned int *tri = &out[adjacency[a] * 3];
+				if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to)
+				{
+					continue; // removed by the collapse
+				}
+				vec3 p[3], q[3];
+				for (int k = 0; k < 3; k++)
+				{
+					p[k] = position(positions, tri[k]);
+					q[k] = tri[k] == collapse.from ? target : p[k];
+				}
+				vec3 before = cross(p[1] - p[0], p[2] - p[0]);
+				vec3 after = cross(q[1] - q[0], q[2] - q[0]);
+				float lengths = length(before) * length(after);
+				flips = lengths <= 0 || dot(before, after) < MAX_FLIP_COS * lengths;
+			}
+			if (flips)
+			{
+				continue;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+			for (int a = offsets[collapse.from]; a < offsets[collapse.from + 1]; a++)
+			{
+				const unsigned int *tri = &out[adjacency[a] * 3];
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+			}
+			done++;
+		}
+		if (done == 0)
+		{
+			break;
+		}
+
+		// apply the pass, dropping the triangles that became degenerate
+		size_t write = 0;
+		for (size_t i = 0; i < out.size(); i += 3)
+		{
+			unsigned int a = remap[out[i]], b = remap[out[i + 1]], c = remap[out[i + 2]];
+			if (a != b && b != c && a != c)
+			{
+				out[write++] = a;
+				out[write++] = b;
+				out[write++] = c;
+			}
+		}
+		out.resize(write);
+		triangles = (int)out.size() / 3;
+	}
+	return triangles;
+}
+
+}
@@ -0,0 +1,27 @@
+/*
+ * Quadric error edge-collapse simplification (Garland & Heckbert).
+ *
+ * Vertices are only ever collapsed onto other existing vertices, so the
+ * result is a new index list over the same vertex buffer. A Shape can keep
+ * its LOD levels as extra index ranges and draw them from the same VAO.
+ * Vertices on open borders (including attribute seams, where OBJ vertices
+ * are split) stay where they are, which keeps the silhouette and the seams
+ * intact.
+ */
+
+#pragma once
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <vector>
+
+namespace MeshSimplifier
+{
+	// Collapses edges in order of increasing quadric error until at most
+	// targetTriangles remain, or nothing more can be collapsed. Returns the
+	// number of triangles in out.
+	int simplify(const std::vector<float> &positions, const std::vector<unsigned int> &indices,
+		int targetTriangles, std::vector<unsigned int> &out);
+}
+
+#endif // MESHSIMPLIFIER_H
@@ -0,0 +1,195 @@
+#include "Meshlets.h"
+
+#include <cfloat>
+#include <cmath>
+
+using namespace std;
+using namespace glm;
+
+// Normals spread more than this (dot with the axis) make the cone useless
+static const float MIN_CONE_DOT = 0.1f;
+
+static vec3 position(const vector<float> &positions, unsigned int v)
+{
+	return vec3(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+}
+
+static void computeBounds(const vector<float> &positions, const vector<unsigned int> &indices, Meshlet &meshlet)
+{
+	vec3 bmin = vec3(FLT_MAX);
+	vec3 bmax = vec3(-FLT_MAX);
+	for (int i = meshlet.first; i < meshlet.first + meshlet.count; i++)
+	{
+		vec3 p = position(positions, indices[i]);
+		bmin = glm::min(bmin, p);
+		bmax = glm::max(bmax, p);
+	}
+	meshlet.center = (bmin + bmax) * 0.5f;
+	meshlet.radius = 0;
+	for (int i = meshlet.first; i < meshlet.first + meshlet.count; i++)
+	{
+		meshlet.radius = (std::max)(meshlet.radius, length(position(positions, indices[i]) - meshlet.center));
+	}
+
+	// the cone axis is the average face normal, its width the widest normal
+	vector<vec3> normals;
+	vec3 axis = vec3(0);
+	for (int i = meshlet.first; i + 2 < meshlet.first + meshlet.count; i += 3)
+	{
+		vec3 p0 = position(positions, indices[i]);
+		vec3 n = cross(position(positions, indices[i + 1]) - p0, position(positions, indices[i + 2]) - p0);
+		float len = length(n);
+		normals.push_back(len > 0 ? n / len : vec3(0));
+		axis += normals.back();
+	}
+	meshlet.coneAxis = length(axis) > 0 ? normalize(axis) : vec3(0, 0, 1);
+	meshlet.coneApex = meshlet.center;
+	meshlet.coneCutoff = 2;
+
+	float minDot = 1;
+	for (size_t t = 0; t < normals.size(); t++)
+	{
+		minDot = (std::min)(minDot, dot(normals[t], meshlet.coneAxis));
+	}
+	if (minDot <= MIN_CONE_DOT)
+	{
+		return;
+	}
+
+	// move the apex back along the axis until it is behind every triangle
+	float maxT = 0;
+	for (size_t t = 0; t < normals.size(); t++)
+	{
+		vec3 p0 = position(positions, indices[meshlet.first + t * 3]);
+		float d = dot(normals[t], meshlet.coneAxis);
+		if (d > 0)
+		{
+			maxT = (std::max)(maxT, dot(normals[t], meshlet.center - p0) / d);
+		}
+	}
+	meshlet.coneApex = meshlet.center - meshlet.coneAxis * maxT;
+	meshlet.coneCutoff = sqrt(1 - minDot * minDot);
+}
+
+namespace Meshlets
+{
+
+void build(const vector<float> &positions, vector<unsigned int> &indices, int first, int count,
+	vector<Meshlet> &out, int maxTriangles, int maxVertices)
+{
+	int numTris = count / 3;
+	int numVerts = (int)positions.size() / 3;
+	if (numTris == 0)
+	{
+		return;
+	}
+
+	// triangles around each vertex, as offsets into one array
+	vector<int> offsets(numVerts + 1, 0);
+	for (int i = first; i < first + numTris * 3; i++)
+	{
+		offsets[indices[i] + 1]++;
+	}
+	for (int v = 0; v < numVerts; v++)
+	{
+		offsets[v + 1] += offsets[v];
+	}
+	vector<int> adjacency(numTris * 3);
+	vector<int> fill(offsets.begin(), offsets.end() - 1);
+	for (int t = 0; t < numTris; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			adjacency[fill[indices[first + t * 3 + k]]++] = t;
+		}
+	}
+
+	// grow each meshlet breadth first from the lowest unassigned triangle,
+	// taking neighbours while the vertex budget allows
+	vector<unsigned int> reordered;
+	reordered.reserve(numTris * 3);
+	vector<bool> assigned(numTris, false);
+	vector<int> vertexMark(numVerts, -1);
+	vector<int> frontier;
+	int seed = 0;
+	int id = 0;
+	while (seed < numTris)
+	{
+		if (assigned[seed])
+		{
+			seed++;
+			continue;
+		}
+
+		Meshlet meshlet;
+		meshlet.first = first + (int)reordered.size();
+		int tris = 0;
+		int verts = 0;
+		frontier.clear();
+		frontier.push_back(seed);
+		for (size_t f = 0; f < frontier.size() && tris < maxTriangles; f++)
+		{
+			int t = frontier[f];
+			if (assigned[t])
+			{
+				continue;
+			}
+			int added = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				added += vertexMark[indices[first + t * 3 + k]] != id ? 1 : 0;
+			}
+			if (verts + added > maxVertices)
+			{
+				continue;
+			}
+
+			assigned[t] = true;
+			tris++;
+			verts += added;
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[first + t * 3 + k];
+				vertexMark[v] = id;
+				reordered.push_back(v);
+				for (int a = offsets[v]; a < offsets[v + 1]; a++)
+				{
+					if (!assigned[adjacency[a]])
+					{
+						frontier.push_back(adjacency[a]);
+					}
+				}
+			}
+		}
+		meshlet.count = tris * 3;
+		out.push_back(meshlet);
+		id++;
+	}
+
+	std::copy(reordered.begin(), reordered.end(), indices.begin() + first);
+	for (size_t m = out.size() - id; m < out.size(); m++)
+	{
+		computeBounds(positions, indices, out[m]);
+	}
+}
+
+bool isBackfacing(const Meshlet &meshlet, const vec3 &eye)
+{
+	vec3 toApex = meshlet.coneApex - eye;
+	float len = length(toApex);
+	return len > 0 && dot(toApex, meshlet.coneAxis) >= meshlet.coneCutoff * len;
+}
+
+bool isOutside(const Meshlet &meshlet, const vec4 planes[6])
+{
+	for (int p = 0; p < 6; p++)
+	{
+		if (dot(vec3(planes[p]), meshlet.center) + planes[p].w < -meshlet.radius)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+}
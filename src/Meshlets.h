@@ -0,0 +1,43 @@
+/*
+ * Meshlets: a mesh's triangles split into small clusters that can be culled
+ * as a unit on the CPU.
+ *
+ * Clustering reorders the triangles in the index buffer so each meshlet is
+ * one contiguous index range. That way the surviving meshlets go to
+ * glMultiDrawElements as ranges, and neighbouring survivors merge into one
+ * range. Every meshlet has a bounding sphere for frustum tests and a normal
+ * cone for backface tests, both in the mesh's local space.
+ */
+
+#pragma once
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+struct Meshlet
+{
+	glm::vec3 center; // bounding sphere
+	float radius;
+	glm::vec3 coneApex; // every triangle faces away from eyes inside the cone behind the apex
+	float coneCutoff; // sine of the cone's half angle, > 1 when the normals spread too far
+	glm::vec3 coneAxis;
+	int first; // first index
+	int count; // number of indices
+};
+
+namespace Meshlets
+{
+	// Reorders the triangles of indices[first, first + count) into meshlets
+	// of at most maxTriangles triangles and maxVertices distinct vertices,
+	// and appends the meshlets to out
+	void build(const std::vector<float> &positions, std::vector<unsigned int> &indices, int first, int count,
+		std::vector<Meshlet> &out, int maxTriangles = 124, int maxVertices = 64);
+
+	// eye and planes in the same space as the meshlet (planes as (n, d), dot(n, p) + d >= 0 inside)
+	bool isBackfacing(const Meshlet &meshlet, const glm::vec3 &eye);
+	bool isOutside(const Meshlet &meshlet, const glm::vec4 planes[6]);
+}
+
+#endif // MESHLETS_H
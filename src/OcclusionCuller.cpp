@@ -0,0 +1,267 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define OCCLUSION_SSE
+#include <xmmintrin.h>
+#endif
+
+#include "Shape.h"
+#include "physics/GameObject.h"
+
+using namespace std;
+using namespace glm;
+
+// rows per band handed to one worker, a whole number of tile rows
+static const int BAND_HEIGHT = 2 * OcclusionCuller::TILE;
+
+// anything closer to the eye than this is treated as crossing the near plane
+static const float MIN_W = 1e-3f;
+
+OcclusionCuller::OcclusionCuller(int width, int height, WorkerPool *pool) :
+	pool(pool),
+	width((width + TILE - 1) / TILE * TILE),
+	height((height + TILE - 1) / TILE * TILE),
+	PV(1),
+	tested(0),
+	occluded(0),
+	rasterTime(0),
+	testTime(0)
+{
+	tilesX = this->width / TILE;
+	tilesY = this->height / TILE;
+	depth.assign(this->width * this->height, 1.0f);
+	tileMax.assign(tilesX * tilesY, 1.0f);
+}
+
+void OcclusionCuller::begin(const mat4 &PV)
+{
+	this->PV = PV;
+	triangles.clear();
+	tested = occluded = 0;
+}
+
+void OcclusionCuller::addOccluder(const Shape &shape, const mat4 &M)
+{
+	const vector<float> &pos = shape.getPositions();
+	const vector<unsigned int> &ele = shape.getIndices();
+	mat4 MVP = PV * M;
+
+	vector<vec3> screen(pos.size() / 3);
+	vector<bool> behind(pos.size() / 3);
+	for (size_t i = 0; i < screen.size(); i++)
+	{
+		vec4 clip = MVP * vec4(pos[i * 3], pos[i * 3 + 1], pos[i * 3 + 2], 1);
+		behind[i] = clip.w < MIN_W;
+		if (!behind[i])
+		{
+			vec3 ndc = vec3(clip) / clip.w;
+			screen[i] = vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f);
+		}
+	}
+	for (size_t i = 0; i + 2 < ele.size(); i += 3)
+	{
+		if (behind[ele[i]] || behind[ele[i + 1]] || behind[ele[i + 2]])
+		{
+			continue;
+		}
+		Triangle tri;
+		tri.v[0] = screen[ele[i]];
+		tri.v[1] = screen[ele[i + 1]];
+		tri.v[2] = screen[ele[i + 2]];
+		triangles.push_back(tri);
+	}
+}
+
+void OcclusionCuller::rasterize()
+{
+	auto start = chrono::high_resolution_clock::now();
+	int bands = (height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+	pool->parallelFor(bands, 1, [&](int begin, int end) {
+		for (int band = begin; band < end; band++)
+		{
+			rasterizeBand(band);
+		}
+	});
+	rasterTime = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+void OcclusionCuller::rasterizeBand(int band)
+{
+	int minY = band * BAND_HEIGHT;
+	int maxY = (std::min)(minY + BAND_HEIGHT, height);
+	std::fill(depth.begin() + minY * width, depth.begin() + maxY * width, 1.0f);
+
+	for (size_t i = 0; i < triangles.size(); i++)
+	{
+		drawTriangle(triangles[i], minY, maxY);
+	}
+
+	for (int ty = minY / TILE; ty < maxY / TILE; ty++)
+	{
+		for (int tx = 0; tx < tilesX; tx++)
+		{
+			float farthest = 0;
+			for (int y = ty * TILE; y < (ty + 1) * TILE; y++)
+			{
+				const float *row = &depth[y * width + tx * TILE];
+				for (int x = 0; x < TILE; x++)
+				{
+					farthest = (std::max)(farthest, row[x]);
+				}
+			}
+			tileMax[ty * tilesX + tx] = farthest;
+		}
+	}
+}
+
+// Rows [minY, maxY) of the triangle, pixel centers at +0.5
+void OcclusionCuller::drawTriangle(const Triangle &tri, int minY, int maxY)
+{
+	vec3 a = tri.v[0], b = tri.v[1], c = tri.v[2];
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (fabs(area) < 1e-8f)
+	{
+		return;
+	}
+	// occluders are drawn from both sides
+	if (area < 0)
+	{
+		std::swap(b, c);
+		area = -area;
+	}
+
+	int x0 = (std::max)((int)floor((std::min)((std::min)(a.x, b.x), c.x)), 0);
+	int x1 = (std::min)((int)ceil((std::max)((std::max)(a.x, b.x), c.x)), width);
+	int y0 = (std::max)((int)floor((std::min)((std::min)(a.y, b.y), c.y)), minY);
+	int y1 = (std::min)((int)ceil((std::max)((std::max)(a.y, b.y), c.y)), maxY);
+	if (x0 >= x1 || y0 >= y1)
+	{
+		return;
+	}
+	x0 &= ~3; // whole groups of four, the width is a multiple of the tile size
+
+	// edge functions E(x, y) = A * x + B * y + C, >= 0 inside
+	float A0 = b.y - c.y, B0 = c.x - b.x, C0 = b.x * c.y - b.y * c.x;
+	float A1 = c.y - a.y, B1 = a.x - c.x, C1 = c.x * a.y - c.y * a.x;
+	float A2 = a.y - b.y, B2 = b.x - a.x, C2 = a.x * b.y - a.y * b.x;
+	// depth is linear in screen space: z = a.z + w1 * (b.z - a.z) + w2 * (c.z - a.z)
+	float invArea = 1.0f / area;
+	float zA = (A1 * (b.z - a.z) + A2 * (c.z - a.z)) * invArea;
+	float zB = (B1 * (b.z - a.z) + B2 * (c.z - a.z)) * invArea;
+	float zC = a.z + (C1 * (b.z - a.z) + C2 * (c.z - a.z)) * invArea;
+
+#ifdef OCCLUSION_SSE
+	__m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	__m128 stepX = _mm_set1_ps(4.0f);
+	__m128 zero = _mm_setzero_ps();
+	for (int y = y0; y < y1; y++)
+	{
+		float py = y + 0.5f;
+		__m128 px = _mm_add_ps(_mm_set1_ps((float)x0), lane);
+		float *row = &depth[y * width];
+		for (int x = x0; x < x1; x += 4)
+		{
+			__m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A0), px), _mm_set1_ps(B0 * py + C0));
+			__m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A1), px), _mm_set1_ps(B1 * py + C1));
+			__m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A2), px), _mm_set1_ps(B2 * py + C2));
+			__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+			if (_mm_movemask_ps(inside) != 0)
+			{
+				__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zA), px), _mm_set1_ps(zB * py + zC));
+				__m128 old = _mm_loadu_ps(row + x);
+				__m128 nearest = _mm_min_ps(old, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+			}
+			px = _mm_add_ps(px, stepX);
+		}
+	}
+#else
+	for (int y = y0; y < y1; y++)
+	{
+		float py = y + 0.5f;
+		float *row = &depth[y * width];
+		for (int x = x0; x < x1; x++)
+		{
+			float px = x + 0.5f;
+			if (A0 * px + B0 * py + C0 >= 0 && A1 * px + B1 * py + C1 >= 0 && A2 * px + B2 * py + C2 >= 0)
+			{
+				row[x] = (std::min)(row[x], zA * px + zB * py + zC);
+			}
+		}
+	}
+#endif
+}
+
+bool OcclusionCuller::isVisible(const vec3 &min, const vec3 &max) const
+{
+	vec3 smin = vec3(FLT_MAX);
+	vec3 smax = vec3(-FLT_MAX);
+	for (int c = 0; c < 8; c++)
+	{
+		vec4 clip = PV * vec4(c & 1 ? max.x : min.x, c & 2 ? max.y : min.y, c & 4 ? max.z : min.z, 1);
+		if (clip.w < MIN_W)
+		{
+			// reaches behind the camera, can't be projected
+			return true;
+		}
+		vec3 ndc = vec3(clip) / clip.w;
+		vec3 s = vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f);
+		smin = glm::min(smin, s);
+		smax = glm::max(smax, s);
+	}
+
+	int tx0 = (std::max)((int)floor(smin.x) / TILE, 0);
+	int tx1 = (std::min)((int)ceil(smax.x) / TILE, tilesX - 1);
+	int ty0 = (std::max)((int)floor(smin.y) / TILE, 0);
+	int ty1 = (std::min)((int)ceil(smax.y) / TILE, tilesY - 1);
+	if (tx0 > tx1 || ty0 > ty1)
+	{
+		// off screen, that's for the frustum test to decide
+		return true;
+	}
+	for (int ty = ty0; ty <= ty1; ty++)
+	{
+		for (int tx = tx0; tx <= tx1; tx++)
+		{
+			if (smin.z <= tileMax[ty * tilesX + tx])
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+int OcclusionCuller::cull(const vector<GameObject *> &objects)
+{
+	auto start = chrono::high_resolution_clock::now();
+	int hidden = 0;
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		GameObject *object = objects[i];
+		if (!object->inView || object->model == NULL)
+		{
+			continue;
+		}
+		mat4 M = object->getModelMatrix();
+		vec3 center = vec3(M * vec4((object->model->min + object->model->max) * 0.5f, 1));
+		vec3 localExtent = (object->model->max - object->model->min) * 0.5f;
+		mat3 R = mat3(M);
+		vec3 extent = mat3(glm::abs(R[0]), glm::abs(R[1]), glm::abs(R[2])) * localExtent;
+
+		tested++;
+		if (!isVisible(center - extent, center + extent))
+		{
+			object->inView = false;
+			hidden++;
+		}
+	}
+	occluded += hidden;
+	testTime = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - start).count();
+	return hidden;
+}
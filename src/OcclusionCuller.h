@@ -0,0 +1,83 @@
+/*
+ * Software occlusion culling on the CPU.
+ *
+ * A few large occluder meshes are rasterized into a small depth buffer,
+ * keeping the nearest depth per pixel. The buffer is split into horizontal
+ * bands that the worker pool rasterizes independently, four pixels at a
+ * time with SSE. Each band then reduces its 8x8 tiles to their farthest
+ * depth. isVisible() projects a world space box and compares its nearest
+ * depth against the tiles it covers. A box that is in front of any covered
+ * tile counts as visible.
+ *
+ * Triangles that cross the near plane are dropped. This only loses
+ * occlusion, it never hides anything that is visible. Nothing here touches
+ * GL, so it also runs headless.
+ */
+
+#pragma once
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "WorkerPool.h"
+
+class Shape;
+class GameObject;
+
+class OcclusionCuller
+{
+public:
+	// width and height are rounded up to multiples of the tile size
+	OcclusionCuller(int width = 256, int height = 128, WorkerPool *pool = &WorkerPool::shared());
+
+	// Starts a frame, clears the occluders
+	void begin(const glm::mat4 &PV);
+	void addOccluder(const Shape &shape, const glm::mat4 &M);
+	// Fills the depth buffer from the occluders added since begin()
+	void rasterize();
+
+	bool isVisible(const glm::vec3 &min, const glm::vec3 &max) const;
+	// Clears inView on objects hidden behind the occluders, returns how many
+	int cull(const std::vector<GameObject *> &objects);
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	const std::vector<float> &getDepth() const { return depth; } // row major, 0 near, 1 far
+
+	// counts of the last frame
+	int getOccluderTriangles() const { return (int)triangles.size(); }
+	int getTested() const { return tested; }
+	int getOccluded() const { return occluded; }
+	float getRasterTime() const { return rasterTime; } // milliseconds
+	float getTestTime() const { return testTime; }
+
+	static const int TILE = 8;
+
+private:
+	// screen space, x and y in pixels, z in [0, 1]
+	struct Triangle
+	{
+		glm::vec3 v[3];
+	};
+
+	void rasterizeBand(int band);
+	void drawTriangle(const Triangle &tri, int minY, int maxY);
+
+	WorkerPool *pool;
+	int width, height;
+	int tilesX, tilesY;
+	glm::mat4 PV;
+
+	std::vector<Triangle> triangles;
+	std::vector<float> depth;
+	std::vector<float> tileMax; // farthest depth in each tile
+
+	int tested;
+	int occluded;
+	float rasterTime;
+	float testTime;
+};
+
+#endif // OCCLUSIONCULLER_H
@@ -0,0 +1,128 @@
+#include "Picker.h"
+
+#include <cfloat>
+
+#include "MeshBVH.h"
+
+using namespace std;
+using namespace glm;
+
+void Picker::clear()
+{
+	instances.clear();
+	dirty = true;
+}
+
+void Picker::add(const shared_ptr<Shape> &shape, const mat4 &M, int id, GameObject *object)
+{
+	Instance instance;
+	instance.shape = shape;
+	instance.M = M;
+	instance.id = id;
+	instance.object = object;
+	instances.push_back(instance);
+	dirty = true;
+}
+
+void Picker::add(const vector<shared_ptr<Shape>> &parts, const mat4 &M, int id)
+{
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		add(parts[i], M, id);
+	}
+}
+
+void Picker::build()
+{
+	vector<vec3> mins(instances.size());
+	vector<vec3> maxs(instances.size());
+	for (size_t i = 0; i < instances.size(); i++)
+	{
+		const Instance &instance = instances[i];
+		vec3 lo = instance.shape->min;
+		vec3 hi = instance.shape->max;
+		mins[i] = vec3(FLT_MAX);
+		maxs[i] = vec3(-FLT_MAX);
+		for (int c = 0; c < 8; c++)
+		{
+			vec3 corner = vec3(c & 1 ? hi.x : lo.x, c & 2 ? hi.y : lo.y, c & 4 ? hi.z : lo.z);
+			vec3 w = vec3(instance.M * vec4(corner, 1));
+			mins[i] = glm::min(mins[i], w);
+			maxs[i] = glm::max(maxs[i], w);
+		}
+	}
+	tree.build(mins, maxs, 1);
+	dirty = false;
+}
+
+bool Picker::pick(const vec3 &origin, const vec3 &dir, PickResult &result)
+{
+	if (dirty)
+	{
+		build();
+	}
+	if (tree.empty())
+	{
+		return false;
+	}
+
+	vec3 invDir = 1.0f / dir;
+	bool found = false;
+	float best = FLT_MAX;
+
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const BoundsNode &node = tree.nodes[stack[--top]];
+		float tEnter;
+		if (!BoundsTree::intersectRay(origin, invDir, node.min, node.max, best, tEnter))
+		{
+			continue;
+		}
+		if (node.count == 0)
+		{
+			stack[top++] = node.first;
+			stack[top++] = node.first + 1;
+			continue;
+		}
+
+		for (int i = node.first; i < node.first + node.count; i++)
+		{
+			const Instance &instance = instances[tree.items[i]];
+
+			// the local direction is left unnormalized so t stays in world units
+			mat4 invM = inverse(instance.M);
+			vec3 localOrigin = vec3(invM * vec4(origin, 1));
+			vec3 localDir = vec3(invM * vec4(dir, 0));
+
+			RayHit hit;
+			if (instance.shape->getBVH().intersect(localOrigin, localDir, best, hit))
+			{
+				best = hit.t;
+				result.id = instance.id;
+				result.object = instance.object;
+				result.shape = instance.shape;
+				result.triangle = hit.triangle;
+				result.bary = hit.bary;
+				result.distance = hit.t;
+				result.position = origin + dir * hit.t;
+				found = true;
+			}
+		}
+	}
+	return found;
+}
+
+void Picker::unproject(double x, double y, int width, int height,
+	const mat4 &P, const mat4 &V, vec3 &origin, vec3 &dir)
+{
+	float ndcX = (float)(2.0 * x / width - 1.0);
+	float ndcY = (float)(1.0 - 2.0 * y / height);
+	mat4 invPV = inverse(P * V);
+	vec4 nearPoint = invPV * vec4(ndcX, ndcY, -1, 1);
+	vec4 farPoint = invPV * vec4(ndcX, ndcY, 1, 1);
+	origin = vec3(nearPoint) / nearPoint.w;
+	dir = normalize(vec3(farPoint) / farPoint.w - origin);
+}
@@ -0,0 +1,67 @@
+/*
+ * Click-to-select on real geometry.
+ *
+ * Every frame the renderer registers what it drew with add(). pick() then
+ * casts a ray through a two level structure: a BoundsTree over the world
+ * bounds of the registered instances, and each Shape's triangle BVH (in
+ * local space, built when MeshCache loads the mesh and shared by every
+ * instance). GameObjects are registered with a pointer to themselves, which
+ * pick() hands back.
+ */
+
+#pragma once
+#ifndef PICKER_H
+#define PICKER_H
+
+#include <vector>
+#include <memory>
+#include <glm/glm.hpp>
+
+#include "Shape.h"
+#include "BoundsTree.h"
+
+class GameObject;
+
+struct PickResult
+{
+	int id; // id passed to add()
+	GameObject *object; // object passed to add(), NULL for plain meshes
+	std::shared_ptr<Shape> shape; // the part that was hit
+	int triangle;
+	glm::vec2 bary; // barycentrics of the triangle's 2nd and 3rd vertex
+	float distance;
+	glm::vec3 position; // world space
+};
+
+class Picker
+{
+public:
+	void clear();
+	void add(const std::shared_ptr<Shape> &shape, const glm::mat4 &M, int id, GameObject *object = NULL);
+	void add(const std::vector<std::shared_ptr<Shape>> &parts, const glm::mat4 &M, int id);
+
+	bool pick(const glm::vec3 &origin, const glm::vec3 &dir, PickResult &result);
+
+	// world space ray through a cursor position given in framebuffer pixels
+	static void unproject(double x, double y, int width, int height,
+		const glm::mat4 &P, const glm::mat4 &V, glm::vec3 &origin, glm::vec3 &dir);
+
+	int getNumInstances() const { return (int)instances.size(); }
+
+private:
+	struct Instance
+	{
+		std::shared_ptr<Shape> shape;
+		glm::mat4 M;
+		int id;
+		GameObject *object;
+	};
+
+	void build();
+
+	std::vector<Instance> instances;
+	BoundsTree tree;
+	bool dirty = true;
+};
+
+#endif // PICKER_H
@@ -0,0 +1,332 @@
+// M_PI on MSVC, before anything pulls in <cmath>
+#define _USE_MATH_DEFINES
+#include "Primitives.h"
+
+#include <map>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+// Unit icosahedron: (0, +-1, +-t), (+-1, +-t, 0), (+-t, 0, +-1) for the
+// golden ratio t, normalized. Faces are counter-clockwise from outside.
+static constexpr float ICO_A = 0.525731112119133606f;
+static constexpr float ICO_B = 0.850650808352039932f;
+static constexpr float ICOSAHEDRON_VERTICES[12][3] = {
+	{-ICO_A, ICO_B, 0}, {ICO_A, ICO_B, 0}, {-ICO_A, -ICO_B, 0}, {ICO_A, -ICO_B, 0},
+	{0, -ICO_A, ICO_B}, {0, ICO_A, ICO_B}, {0, -ICO_A, -ICO_B}, {0, ICO_A, -ICO_B},
+	{ICO_B, 0, -ICO_A}, {ICO_B, 0, ICO_A}, {-ICO_B, 0, -ICO_A}, {-ICO_B, 0, ICO_A}
+};
+static constexpr unsigned int ICOSAHEDRON_FACES[20][3] = {
+	{0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+	{1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+	{3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+	{4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}
+};
+
+// Cube faces as normal, u, v with u x v = normal
+static constexpr float CUBE_FACES[6][3][3] = {
+	{{1, 0, 0}, {0, 0, -1}, {0, 1, 0}},
+	{{-1, 0, 0}, {0, 0, 1}, {0, 1, 0}},
+	{{0, 1, 0}, {1, 0, 0}, {0, 0, -1}},
+	{{0, -1, 0}, {1, 0, 0}, {0, 0, 1}},
+	{{0, 0, 1}, {1, 0, 0}, {0, 1, 0}},
+	{{0, 0, -1}, {-1, 0, 0}, {0, 1, 0}}
+};
+
+static const int MAX_ICOSPHERE_DETAIL = 7;
+static const int MAX_LODS = 3;
+
+int Primitives::getDefaultDetail(Type type)
+{
+	switch (type)
+	{
+	case ICOSPHERE:
+	case CUBE:
+		return 1;
+	default:
+		return 16;
+	}
+}
+
+const char *Primitives::getName(Type type)
+{
+	static const char *names[] = {"sphere", "icosphere", "cube", "cylinder", "capsule"};
+	return type >= 0 && type < NUM_TYPES ? names[type] : "unknown";
+}
+
+static void addVertex(tinyobj::shape_t &mesh, const vec3 &p, const vec3 &n, const vec2 &uv)
+{
+	mesh.mesh.positions.push_back(p.x);
+	mesh.mesh.positions.push_back(p.y);
+	mesh.mesh.positions.push_back(p.z);
+	mesh.mesh.normals.push_back(n.x);
+	mesh.mesh.normals.push_back(n.y);
+	mesh.mesh.normals.push_back(n.z);
+	mesh.mesh.texcoords.push_back(uv.x);
+	mesh.mesh.texcoords.push_back(uv.y);
+}
+
+static vector<int> everyNth(int first, int last, int step)
+{
+	vector<int> rows;
+	for (int r = first; r <= last; r += step)
+	{
+		rows.push_back(r);
+	}
+	return rows;
+}
+
+// Two triangles per cell between consecutive listed rows of a vertex grid,
+// every step-th column. Rows run from the top down and columns to the left
+// as seen from outside, which makes the triangles counter-clockwise. With
+// poleTop (poleBottom) the first (last) row is a pole and its degenerate
+// triangles are left out.
+static void grid(vector<unsigned int> &out, unsigned int base, int rowLength, const vector<int> &rows,
+	int columns, int step, bool poleTop, bool poleBottom)
+{
+	for (size_t r = 0; r + 1 < rows.size(); r++)
+	{
+		for (int c = 0; c < columns; c += step)
+		{
+			unsigned int a = base + rows[r] * rowLength + c;
+			unsigned int b = base + rows[r + 1] * rowLength + c;
+			if (!(poleTop && r == 0))
+			{
+				out.push_back(a);
+				out.push_back(a + step);
+				out.push_back(b);
+			}
+			if (!(poleBottom && r + 2 == rows.size()))
+			{
+				out.push_back(a + step);
+				out.push_back(b + step);
+				out.push_back(b);
+			}
+		}
+	}
+}
+
+// The first level generated is the mesh itself, the rest are LODs
+static void addLevel(tinyobj::shape_t &mesh, vector<vector<unsigned int>> &lods, vector<unsigned int> &level)
+{
+	if (mesh.mesh.indices.empty())
+	{
+		mesh.mesh.indices.swap(level);
+	}
+	else
+	{
+		lods.push_back(level);
+	}
+}
+
+static vec3 around(float theta, float phi)
+{
+	return vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+}
+
+static void sphere(int detail, tinyobj::shape_t &mesh, vector<vector<unsigned int>> &lods)
+{
+	int segments = ((std::max)(detail, 4) + 3) / 4 * 4;
+	int rings = segments / 2;
+	for (int r = 0; r <= rings; r++)
+	{
+		for (int s = 0; s <= segments; s++)
+		{
+			vec3 n = around((float)M_PI * r / rings, 2.0f * (float)M_PI * s / segments);
+			addVertex(mesh, n, n, vec2(s / (float)segments, 1.0f - r / (float)rings));
+		}
+	}
+	grid(mesh.mesh.indices, 0, segments + 1, everyNth(0, rings, 1), segments, 1, true, true);
+	for (int step = 2; (int)lods.size() < MAX_LODS && rings % step == 0 && rings / step >= 2; step *= 2)
+	{
+		lods.push_back(vector<unsigned int>());
+		grid(lods.back(), 0, segments + 1, everyNth(0, rings, step), segments, step, true, true);
+	}
+}
+
+static void icosphere(int detail, tinyobj::shape_t &mesh, vector<vector<unsigned int>> &lods)
+{
+	detail = (std::min)((std::max)(detail, 0), MAX_ICOSPHERE_DETAIL);
+	vector<vec3> points;
+	for (int i = 0; i < 12; i++)
+	{
+		points.push_back(vec3(ICOSAHEDRON_VERTICES[i][0], ICOSAHEDRON_VERTICES[i][1], ICOSAHEDRON_VERTICES[i][2]));
+	}
+	// every level keeps the vertices of the one before, so all levels index
+	// the final vertex list
+	vector<vector<unsigned int>> levels(1);
+	levels[0].assign(&ICOSAHEDRON_FACES[0][0], &ICOSAHEDRON_FACES[0][0] + 60);
+	for (int level = 1; level <= detail; level++)
+	{
+		map<uint64_t, unsigned int> midpoints;
+		const vector<unsigned int> &faces = levels[level - 1];
+		vector<unsigned int> next;
+		for (size_t f = 0; f < faces.size(); f += 3)
+		{
+			unsigned int mid[3];
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned int a = faces[f + e], b = faces[f + (e + 1) % 3];
+				uint64_t key = ((uint64_t)(std::min)(a, b) << 32) | (std::max)(a, b);
+				map<uint64_t, unsigned int>::iterator it = midpoints.find(key);
+				if (it == midpoints.end())
+				{
+					it = midpoints.insert(make_pair(key, (unsigned int)points.size())).first;
+					points.push_back(normalize(points[a] + points[b]));
+				}
+				mid[e] = it->second;
+			}
+			unsigned int split[12] = {faces[f], mid[0], mid[2], mid[0], faces[f + 1], mid[1],
+				mid[2], mid[1], faces[f + 2], mid[0], mid[1], mid[2]};
+			next.insert(next.end(), split, split + 12);
+		}
+		levels.push_back(next);
+	}
+
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		const vec3 &p = points[i];
+		vec2 uv(0.5f + atan2(p.z, p.x) / (2.0f * (float)M_PI), 0.5f + asin(p.y) / (float)M_PI);
+		addVertex(mesh, p, p, uv);
+	}
+	mesh.mesh.indices = levels[detail];
+	for (int level = detail - 1; level >= 0 && (int)lods.size() < MAX_LODS; level--)
+	{
+		lods.push_back(levels[level]);
+	}
+}
+
+static void cube(int detail, tinyobj::shape_t &mesh, vector<vector<unsigned int>> &lods)
+{
+	int cells = (std::max)(detail, 1);
+	int levels = 1;
+	for (int step = 2; levels <= MAX_LODS && cells % step == 0; step *= 2)
+	{
+		levels++;
+	}
+	lods.resize(levels - 1);
+	for (int f = 0; f < 6; f++)
+	{
+		vec3 n(CUBE_FACES[f][0][0], CUBE_FACES[f][0][1], CUBE_FACES[f][0][2]);
+		vec3 u(CUBE_FACES[f][1][0], CUBE_FACES[f][1][1], CUBE_FACES[f][1][2]);
+		vec3 v(CUBE_FACES[f][2][0], CUBE_FACES[f][2][1], CUBE_FACES[f][2][2]);
+		unsigned int base = (unsigned int)mesh.mesh.positions.size() / 3;
+		for (int r = 0; r <= cells; r++)
+		{
+			for (int c = 0; c <= cells; c++)
+			{
+				float x = 1.0f - c / (float)cells, y = 1.0f - r / (float)cells;
+				addVertex(mesh, (n + u * (x * 2 - 1) + v * (y * 2 - 1)) * 0.5f, n, vec2(x, y));
+			}
+		}
+		grid(mesh.mesh.indices, base, cells + 1, everyNth(0, cells, 1), cells, 1, false, false);
+		for (int l = 1; l < levels; l++)
+		{
+			int step = 1 << l;
+			grid(lods[l - 1], base, cells + 1, everyNth(0, cells, step), cells, step, false, false);
+		}
+	}
+}
+
+// Triangle fan around a cap center, counter-clockwise from above for the top
+static void cap(vector<unsigned int> &out, unsigned int center, int segments, int step, bool top)
+{
+	for (int s = 0; s < segments; s += step)
+	{
+		out.push_back(center);
+		out.push_back(center + 1 + (top ? s + step : s));
+		out.push_back(center + 1 + (top ? s : s + step));
+	}
+}
+
+static void cylinder(int detail, tinyobj::shape_t &mesh, vector<vector<unsigned int>> &lods)
+{
+	int segments = (std::max)(detail, 3);
+	for (int r = 0; r < 2; r++)
+	{
+		for (int s = 0; s <= segments; s++)
+		{
+			vec3 n = around((float)M_PI_2, 2.0f * (float)M_PI * s / segments);
+			addVertex(mesh, n + vec3(0, r == 0 ? 1 : -1, 0), n, vec2(s / (float)segments, 1.0f - r));
+		}
+	}
+	unsigned int caps[2];
+	for (int c = 0; c < 2; c++)
+	{
+		float y = c == 0 ? 1.0f : -1.0f;
+		caps[c] = (unsigned int)mesh.mesh.positions.size() / 3;
+		addVertex(mesh, vec3(0, y, 0), vec3(0, y, 0), vec2(0.5f));
+		for (int s = 0; s <= segments; s++)
+		{
+			vec3 p = around((float)M_PI_2, 2.0f * (float)M_PI * s / segments);
+			addVertex(mesh, p + vec3(0, y, 0), vec3(0, y, 0), vec2(p.x, p.z) * 0.5f + 0.5f);
+		}
+	}
+
+	for (int step = 1; (int)lods.size() < MAX_LODS && segments % step == 0 && segments / step >= 3; step *= 2)
+	{
+		vector<unsigned int> level;
+		grid(level, 0, segments + 1, everyNth(0, 1, 1), segments, step, false, false);
+		cap(level, caps[0], segments, step, true);
+		cap(level, caps[1], segments, step, false);
+		addLevel(mesh, lods, level);
+	}
+}
+
+static void capsule(int detail, tinyobj::shape_t &mesh, vector<vector<unsigned int>> &lods)
+{
+	// a sphere of radius 0.5 split at the equator, the halves 1 apart
+	int segments = ((std::max)(detail, 4) + 3) / 4 * 4;
+	int half = segments / 4; // rings per hemisphere
+	int rows = 2 * half + 1;
+	for (int r = 0; r <= rows; r++)
+	{
+		bool top = r <= half;
+		float theta = (float)M_PI_2 * (top ? r : r - 1) / half;
+		for (int s = 0; s <= segments; s++)
+		{
+			vec3 n = around(theta, 2.0f * (float)M_PI * s / segments);
+			addVertex(mesh, n * 0.5f + vec3(0, top ? 0.5f : -0.5f, 0), n, vec2(s / (float)segments, 1.0f - r / (float)rows));
+		}
+	}
+
+	for (int step = 1; (int)lods.size() < MAX_LODS && half % step == 0 && segments / step >= 4; step *= 2)
+	{
+		vector<int> levelRows = everyNth(0, half, step);
+		vector<int> bottom = everyNth(half + 1, rows, step);
+		levelRows.insert(levelRows.end(), bottom.begin(), bottom.end());
+		vector<unsigned int> level;
+		grid(level, 0, segments + 1, levelRows, segments, step, true, true);
+		addLevel(mesh, lods, level);
+	}
+}
+
+void Primitives::generate(Type type, int detail, tinyobj::shape_t &mesh, vector<vector<unsigned int>> &lods)
+{
+	mesh = tinyobj::shape_t();
+	lods.clear();
+	switch (type)
+	{
+	case SPHERE:
+		sphere(detail, mesh, lods);
+		break;
+	case ICOSPHERE:
+		icosphere(detail, mesh, lods);
+		break;
+	case CUBE:
+		cube(detail, mesh, lods);
+		break;
+	case CYLINDER:
+		cylinder(detail, mesh, lods);
+		break;
+	case CAPSULE:
+		capsule(detail, mesh, lods);
+		break;
+	default:
+		break;
+	}
+}
@@ -0,0 +1,47 @@
+/*
+ * Procedural primitive meshes.
+ *
+ * generate() builds a primitive at any level of detail straight into the
+ * arrays Shape::createShape takes, along with up to three coarser LOD
+ * levels. The coarser levels use every 2nd, 4th and 8th row and column of
+ * the same vertex grid (earlier subdivision levels for the icosphere), so
+ * they are index lists over the same vertices, like MeshSimplifier output,
+ * and go into Shape::setLODs.
+ *
+ * Sizes match the OBJ files they replace: spheres have radius 1, the cube
+ * spans -0.5 to 0.5, the cylinder and the capsule span -1 to 1 along y with
+ * radius 1 and 0.5.
+ *
+ * Shapes are normally requested through MeshCache::loadPrimitive, which
+ * generates each type and detail once.
+ */
+
+#pragma once
+#ifndef PRIMITIVES_H
+#define PRIMITIVES_H
+
+#include <vector>
+#include <tiny_obj_loader/tiny_obj_loader.h>
+
+namespace Primitives
+{
+	enum Type
+	{
+		SPHERE, // detail = segments around y (rounded up to a multiple of 4), half as many rings
+		ICOSPHERE, // detail = subdivisions of the icosahedron, at most 7
+		CUBE, // detail = quads along each edge of a face
+		CYLINDER, // detail = segments around y, capped
+		CAPSULE, // detail = segments around y (rounded up to a multiple of 4)
+		NUM_TYPES
+	};
+
+	// detail used when none is given. ICOSPHERE 1 matches sphere.obj and
+	// ico_sphere.obj (both are subdivided icosahedra), CUBE 1 cube.obj.
+	int getDefaultDetail(Type type);
+	const char *getName(Type type);
+
+	// lods receives the index lists of the coarser levels, most detailed first
+	void generate(Type type, int detail, tinyobj::shape_t &mesh, std::vector<std::vector<unsigned int>> &lods);
+}
+
+#endif // PRIMITIVES_H
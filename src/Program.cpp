@@ -3,8 +3,12 @@
 #include <iostream>
 #include <cassert>
 #include <fstream>
+#include <cstring>
+
+#include <glm/gtc/type_ptr.hpp>
 
 #include "GLSL.h"
+#include "GLState.h"
 
 
 std::string readFileAsString(const std::string &fileName)
@@ -80,6 +84,13 @@ bool Program::init()
 	pid = glCreateProgram();
 	CHECKED_GL_CALL(glAttachShader(pid, VS));
 	CHECKED_GL_CALL(glAttachShader(pid, FS));
+	CHECKED_GL_CALL(glBindAttribLocation(pid, GLSL::ATTRIB_POS, "vertPos"));
+	CHECKED_GL_CALL(glBindAttribLocation(pid, GLSL::ATTRIB_NOR, "vertNor"));
+	CHECKED_GL_CALL(glBindAttribLocation(pid, GLSL::ATTRIB_TEX, "vertTex"));
+	CHECKED_GL_CALL(glBindAttribLocation(pid, GLSL::ATTRIB_DECODE_BIAS, "vertDecodeBias"));
+	CHECKED_GL_CALL(glBindAttribLocation(pid, GLSL::ATTRIB_DECODE_SCALE, "vertDecodeScale"));
+	CHECKED_GL_CALL(glBindAttribLocation(pid, GLSL::ATTRIB_INSTANCE_M, "instM"));
+	CHECKED_GL_CALL(glBindAttribLocation(pid, GLSL::ATTRIB_INSTANCE_PARAMS, "instParams"));
 	CHECKED_GL_CALL(glLinkProgram(pid));
 	CHECKED_GL_CALL(glGetProgramiv(pid, GL_LINK_STATUS, &rc));
 	if (!rc)
@@ -92,53 +103,169 @@ bool Program::init()
 		return false;
 	}
 
+	// shared uniform blocks
+	static const struct
+	{
+		const char *name;
+		GLuint binding;
+	} blockBindings[] = {
+		{"Camera", GLSL::BINDING_CAMERA},
+		{"Lights", GLSL::BINDING_LIGHTS}
+	};
+	for (size_t i = 0; i < sizeof(blockBindings) / sizeof(blockBindings[0]); i++)
+	{
+		GLuint block = glGetUniformBlockIndex(pid, blockBindings[i].name);
+		if (block != GL_INVALID_INDEX)
+		{
+			CHECKED_GL_CALL(glUniformBlockBinding(pid, block, blockBindings[i].binding));
+		}
+	}
+
+	reflectUniforms();
+
+	// samplers with a fixed texture unit
+	static const struct
+	{
+		const char *name;
+		GLint unit;
+	} samplerUnits[] = {
+		{"objectData", GLSL::UNIT_OBJECT_DATA},
+		{"impostorColor", GLSL::UNIT_IMPOSTOR_COLOR},
+		{"impostorNormal", GLSL::UNIT_IMPOSTOR_NORMAL},
+		{"clusterLights", GLSL::UNIT_CLUSTER_LIGHTS},
+		{"clusterGrid", GLSL::UNIT_CLUSTER_GRID},
+		{"clusterIndices", GLSL::UNIT_CLUSTER_INDICES}
+	};
+	GLState::useProgram(pid);
+	for (size_t i = 0; i < sizeof(samplerUnits) / sizeof(samplerUnits[0]); i++)
+	{
+		// samplers this program doesn't use have no slot and are skipped
+		setUniform(getUniformID(samplerUnits[i].name), samplerUnits[i].unit);
+	}
+	GLState::useProgram(0);
+
 	return true;
 }
 
-void Program::bind()
+std::map<std::string, int> Program::uniformIDs;
+int Program::uploadCount = 0;
+int Program::elidedCount = 0;
+
+int Program::getUniformID(const std::string &name)
 {
-	CHECKED_GL_CALL(glUseProgram(pid));
+	std::map<std::string, int>::iterator it = uniformIDs.find(name);
+	if (it != uniformIDs.end())
+	{
+		return it->second;
+	}
+	int id = (int)uniformIDs.size();
+	uniformIDs[name] = id;
+	return id;
 }
 
-void Program::unbind()
+void Program::reflectUniforms()
 {
-	CHECKED_GL_CALL(glUseProgram(0));
+	GLint count = 0, maxLength = 0;
+	CHECKED_GL_CALL(glGetProgramiv(pid, GL_ACTIVE_UNIFORMS, &count));
+	CHECKED_GL_CALL(glGetProgramiv(pid, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength));
+
+	std::vector<GLchar> buffer((std::max)(maxLength, 1));
+	for (GLint i = 0; i < count; i++)
+	{
+		GLint size;
+		GLenum type;
+		GLsizei length;
+		CHECKED_GL_CALL(glGetActiveUniform(pid, i, (GLsizei)buffer.size(), &length, &size, &type, &buffer[0]));
+		std::string name(&buffer[0], length);
+
+		// arrays are reported as name[0]
+		size_t bracket = name.find('[');
+		if (bracket != std::string::npos)
+		{
+			name = name.substr(0, bracket);
+		}
+
+		// uniform block members have no location
+		GLint location = glGetUniformLocation(pid, name.c_str());
+		if (location < 0)
+		{
+			continue;
+		}
+
+		int id = getUniformID(name);
+		if (id >= (int)slots.size())
+		{
+			slots.resize(id + 1);
+		}
+		slots[id].location = location;
+		slots[id].valid = false;
+	}
 }
 
-void Program::addAttribute(const std::string &name)
+Program::UniformSlot *Program::findSlot(int id, const void *value, size_t bytes)
 {
-	attributes[name] = GLSL::getAttribLocation(pid, name.c_str(), isVerbose());
+	if (id < 0 || id >= (int)slots.size() || slots[id].location < 0)
+	{
+		return NULL;
+	}
+	UniformSlot *slot = &slots[id];
+	if (slot->valid && memcmp(slot->shadow, value, bytes) == 0)
+	{
+		elidedCount++;
+		return NULL;
+	}
+	memcpy(slot->shadow, value, bytes);
+	slot->valid = true;
+	uploadCount++;
+	return slot;
 }
 
-void Program::addUniform(const std::string &name)
+void Program::setUniform(int id, const glm::mat4 &value)
 {
-	uniforms[name] = GLSL::getUniformLocation(pid, name.c_str(), isVerbose());
+	if (UniformSlot *slot = findSlot(id, glm::value_ptr(value), sizeof(value)))
+	{
+		glUniformMatrix4fv(slot->location, 1, GL_FALSE, glm::value_ptr(value));
+	}
 }
 
-GLint Program::getAttribute(const std::string &name) const
+void Program::setUniform(int id, const glm::vec4 &value)
 {
-	std::map<std::string, GLint>::const_iterator attribute = attributes.find(name.c_str());
-	if (attribute == attributes.end())
+	if (UniformSlot *slot = findSlot(id, glm::value_ptr(value), sizeof(value)))
 	{
-		if (isVerbose())
-		{
-			std::cout << name << " is not an attribute variable" << std::endl;
-		}
-		return -1;
+		glUniform4fv(slot->location, 1, glm::value_ptr(value));
 	}
-	return attribute->second;
 }
 
-GLint Program::getUniform(const std::string &name) const
+void Program::setUniform(int id, const glm::vec3 &value)
 {
-	std::map<std::string, GLint>::const_iterator uniform = uniforms.find(name.c_str());
-	if (uniform == uniforms.end())
+	if (UniformSlot *slot = findSlot(id, glm::value_ptr(value), sizeof(value)))
 	{
-		if (isVerbose())
-		{
-			std::cout << name << " is not a uniform variable" << std::endl;
-		}
-		return -1;
+		glUniform3fv(slot->location, 1, glm::value_ptr(value));
 	}
-	return uniform->second;
+}
+
+void Program::setUniform(int id, float value)
+{
+	if (UniformSlot *slot = findSlot(id, &value, sizeof(value)))
+	{
+		glUniform1f(slot->location, value);
+	}
+}
+
+void Program::setUniform(int id, int value)
+{
+	if (UniformSlot *slot = findSlot(id, &value, sizeof(value)))
+	{
+		glUniform1i(slot->location, value);
+	}
+}
+
+void Program::bind()
+{
+	GLState::useProgram(pid);
+}
+
+void Program::unbind()
+{
+	GLState::useProgram(0);
 }
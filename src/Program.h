@@ -6,8 +6,10 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include <glad/glad.h>
+#include <glm/glm.hpp>
 
 
 std::string readFileAsString(const std::string &fileName);
@@ -25,10 +27,23 @@ public:
 	virtual void bind();
 	virtual void unbind();
 
-	void addAttribute(const std::string &name);
-	void addUniform(const std::string &name);
-	GLint getAttribute(const std::string &name) const;
-	GLint getUniform(const std::string &name) const;
+	// attributes sit at the fixed GLSL::AttribLocation slots, bound by name in init()
+
+	// Uniforms are found by reflection in init(). Look an ID up once (it is
+	// the same for every program) and pass it to the setters, which skip the
+	// upload when the program already holds the value. The program has to be
+	// bound. Unknown or inactive IDs are ignored.
+	static int getUniformID(const std::string &name);
+	void setUniform(int id, const glm::mat4 &value);
+	void setUniform(int id, const glm::vec4 &value);
+	void setUniform(int id, const glm::vec3 &value);
+	void setUniform(int id, float value);
+	void setUniform(int id, int value);
+
+	// upload statistics of every program since the last reset (once a frame)
+	static void resetUploadStats() { uploadCount = elidedCount = 0; }
+	static int getUploadCount() { return uploadCount; }
+	static int getElidedCount() { return elidedCount; }
 
 protected:
 
@@ -37,11 +52,24 @@ protected:
 
 private:
 
+	struct UniformSlot
+	{
+		GLint location = -1;
+		bool valid = false; // shadow holds what the program has
+		GLfloat shadow[16];
+	};
+
+	void reflectUniforms();
+	UniformSlot *findSlot(int id, const void *value, size_t bytes);
+
 	GLuint pid = 0;
-	std::map<std::string, GLint> attributes;
-	std::map<std::string, GLint> uniforms;
+	std::vector<UniformSlot> slots; // indexed by uniform ID
 	bool verbose = true;
 
+	static std::map<std::string, int> uniformIDs;
+	static int uploadCount;
+	static int elidedCount;
+
 };
 
 #endif // LAB471_PROGRAM_H_INCLUDED
@@ -0,0 +1,296 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <cfloat>
+
+#include "Program.h"
+#include "Shape.h"
+#include "InstanceBatch.h"
+#include "GLSL.h"
+#include "GLState.h"
+
+using namespace std;
+using namespace glm;
+
+static const int PASS_SHIFT = 62;
+static const int PROGRAM_SHIFT = 54;
+static const int MATERIAL_SHIFT = 44;
+static const int MESH_SHIFT = 28;
+static const uint64_t PROGRAM_MASK = 0xff;
+static const uint64_t MATERIAL_MASK = 0x3ff;
+static const uint64_t MESH_MASK = 0xffff;
+static const uint64_t DEPTH_MASK = 0xfffffff;
+
+RenderQueue::RenderQueue() :
+	view(1),
+	farPlane(100),
+	viewProjection(1),
+	eye(0),
+	projectionScale(1),
+	hasProjection(false),
+	numPlain(0),
+	objectTexture(0),
+	objectTextureSource(0),
+	objectBase(0),
+	programBinds(0),
+	vaoBinds(0),
+	draws(0),
+	instances(0),
+	streamTime(0),
+	triangles(0),
+	meshletTriangles(0),
+	meshletTrianglesTotal(0)
+{
+}
+
+RenderQueue::~RenderQueue()
+{
+	if (objectTexture != 0)
+	{
+		GLState::deleteTexture(objectTexture);
+	}
+}
+
+int RenderQueue::programIndex(Program *prog)
+{
+	for (size_t i = 0; i < programs.size(); i++)
+	{
+		if (programs[i] == prog)
+		{
+			return (int)i;
+		}
+	}
+	programs.push_back(prog);
+	return (int)programs.size() - 1;
+}
+
+int RenderQueue::meshIndex(const Shape *shape)
+{
+	unordered_map<const Shape *, int>::iterator it = meshIDs.find(shape);
+	if (it != meshIDs.end())
+	{
+		return it->second;
+	}
+	int id = (int)meshIDs.size();
+	meshIDs[shape] = id;
+	return id;
+}
+
+void RenderQueue::begin(const mat4 &V, float farPlane)
+{
+	view = V;
+	this->farPlane = farPlane;
+	commands.clear();
+	shapes.clear();
+	transforms.clear();
+	batches.clear();
+	lods.clear();
+	numPlain = 0;
+	hasProjection = false;
+}
+
+void RenderQueue::setProjection(const mat4 &P)
+{
+	viewProjection = P * view;
+	eye = vec3(inverse(view)[3]);
+	projectionScale = P[1][1];
+	hasProjection = true;
+}
+
+float RenderQueue::getScreenSize(const vec3 &center, float radius) const
+{
+	float depth = -(view * vec4(center, 1)).z;
+	if (!hasProjection || depth <= radius)
+	{
+		return FLT_MAX;
+	}
+	return radius * projectionScale / depth;
+}
+
+void RenderQueue::submit(Program *prog, const Shape *shape, const mat4 &M, int material, RenderPass pass, int lod)
+{
+	// view space depth of the object's origin
+	push(prog, shape, M, NULL, -(view * M[3]).z, material, pass, lod);
+}
+
+void RenderQueue::submitInstanced(Program *prog, const Shape *shape, InstanceBatch *batch, int material, RenderPass pass)
+{
+	if (batch->size() > 0)
+	{
+		push(prog, shape, mat4(1), batch, 0, material, pass, 0);
+	}
+}
+
+void RenderQueue::push(Program *prog, const Shape *shape, const mat4 &M, InstanceBatch *batch, float depth, int material, RenderPass pass, int lod)
+{
+	// quantize depth to 28 bits
+	depth = (std::min)((std::max)(depth / farPlane, 0.0f), 1.0f);
+	uint64_t quantized = (uint64_t)(depth * DEPTH_MASK);
+	if (pass == PASS_TRANSPARENT)
+	{
+		quantized = DEPTH_MASK - quantized;
+	}
+
+	Command command;
+	command.key = ((uint64_t)pass << PASS_SHIFT) |
+		(((uint64_t)programIndex(prog) & PROGRAM_MASK) << PROGRAM_SHIFT) |
+		(((uint64_t)material & MATERIAL_MASK) << MATERIAL_SHIFT) |
+		(((uint64_t)meshIndex(shape) & MESH_MASK) << MESH_SHIFT) |
+		quantized;
+	command.index = (uint32_t)shapes.size();
+	commands.push_back(command);
+	shapes.push_back(shape);
+	transforms.push_back(M);
+	batches.push_back(batch);
+	lods.push_back(lod);
+	numPlain += batch == NULL ? 1 : 0;
+}
+
+// LSD radix sort on 8 bits at a time, skipping digits every key shares
+void RenderQueue::radixSort(vector<Command> &commands, vector<Command> &scratch)
+{
+	scratch.resize(commands.size());
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t counts[256] = {0};
+		for (size_t i = 0; i < commands.size(); i++)
+		{
+			counts[(commands[i].key >> shift) & 0xff]++;
+		}
+		if (counts[(commands[0].key >> shift) & 0xff] == commands.size())
+		{
+			continue;
+		}
+
+		size_t offset = 0;
+		for (int d = 0; d < 256; d++)
+		{
+			size_t c = counts[d];
+			counts[d] = offset;
+			offset += c;
+		}
+		for (size_t i = 0; i < commands.size(); i++)
+		{
+			scratch[counts[(commands[i].key >> shift) & 0xff]++] = commands[i];
+		}
+		commands.swap(scratch);
+	}
+}
+
+// One linear pass over the sorted draws, so objectIndex follows draw order
+void RenderQueue::writeObjects()
+{
+	auto start = chrono::high_resolution_clock::now();
+
+	ObjectData *objects = (ObjectData *)objectStream.begin((std::max)(numPlain, 1) * sizeof(ObjectData));
+	int count = 0;
+	for (size_t i = 0; i < commands.size(); i++)
+	{
+		const Command &command = commands[i];
+		if (batches[command.index] != NULL)
+		{
+			continue;
+		}
+		const mat4 &M = transforms[command.index];
+		mat3 N = transpose(inverse(mat3(M)));
+		ObjectData &object = objects[count++];
+		for (int c = 0; c < 4; c++)
+		{
+			object.M[c] = M[c];
+		}
+		for (int c = 0; c < 3; c++)
+		{
+			object.N[c] = vec4(N[c], 0);
+		}
+		object.params = vec4((float)((command.key >> MATERIAL_SHIFT) & MATERIAL_MASK), 0, 0, 0);
+	}
+	objectBase = (int)(objectStream.commit(count * sizeof(ObjectData)) / sizeof(ObjectData));
+
+	// the buffer texture has to follow the buffer when it is reallocated
+	if (objectTexture == 0)
+	{
+		glGenTextures(1, &objectTexture);
+	}
+	GLState::activeTexture(GL_TEXTURE0 + GLSL::UNIT_OBJECT_DATA);
+	GLState::bindTexture(GL_TEXTURE_BUFFER, objectTexture);
+	if (objectTextureSource != objectStream.getBuffer())
+	{
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, objectStream.getBuffer());
+		objectTextureSource = objectStream.getBuffer();
+	}
+	GLState::activeTexture(GL_TEXTURE0);
+
+	streamTime = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+void RenderQueue::execute()
+{
+	static const int uObjectIndex = Program::getUniformID("objectIndex");
+
+	programBinds = vaoBinds = draws = instances = 0;
+	meshletTriangles = meshletTrianglesTotal = triangles = 0;
+	if (commands.empty())
+	{
+		return;
+	}
+	radixSort(commands, scratch);
+	writeObjects();
+
+	Program *bound = NULL;
+	const Shape *boundShape = NULL;
+	int object = objectBase;
+	for (size_t i = 0; i < commands.size(); i++)
+	{
+		const Command &command = commands[i];
+		Program *prog = programs[(command.key >> PROGRAM_SHIFT) & PROGRAM_MASK];
+		const Shape *shape = shapes[command.index];
+
+		// materials don't carry any GL state yet, they only group draws
+		if (prog != bound)
+		{
+			prog->bind();
+			bound = prog;
+			programBinds++;
+		}
+		if (shape != boundShape)
+		{
+			shape->bind();
+			boundShape = shape;
+			vaoBinds++;
+		}
+		InstanceBatch *batch = batches[command.index];
+		if (batch != NULL)
+		{
+			batch->draw(*shape);
+			instances += batch->size();
+		}
+		else
+		{
+			// the one uniform left per plain draw, see the header
+			prog->setUniform(uObjectIndex, object++);
+			int lod = lods[command.index];
+			if (lod > 0)
+			{
+				shape->drawLOD(lod);
+				triangles += shape->getLODTriangles(lod);
+			}
+			else if (Shape::meshletCulling && hasProjection && shape->hasMeshlets())
+			{
+				int drawn = shape->drawMeshlets(transforms[command.index], viewProjection, eye);
+				meshletTriangles += drawn;
+				meshletTrianglesTotal += (int)shape->getIndices().size() / 3;
+				triangles += drawn;
+			}
+			else
+			{
+				shape->drawElements();
+				triangles += (int)shape->getIndices().size() / 3;
+			}
+		}
+		draws++;
+	}
+	objectStream.fence();
+	// the program and VAO stay bound, GLState drops the rebinds next frame
+}
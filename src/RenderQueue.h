@@ -0,0 +1,130 @@
+/*
+ * Sorted draw submission.
+ *
+ * Draws are recorded with submit() as small commands carrying a 64-bit key
+ *
+ *   63..62 pass | 61..54 program | 53..44 material | 43..28 mesh | 27..0 depth
+ *
+ * and execute() radix-sorts the keys, then walks the commands binding a
+ * program or VAO only where that part of the key changes. Opaque draws sort
+ * front to back inside a (program, material, mesh) run, transparent ones
+ * back to front. Commands point at shapes and programs owned elsewhere,
+ * which must stay alive until execute().
+ *
+ * Plain draws don't upload their transform as a uniform: execute() writes
+ * every draw's ObjectData into a StreamBuffer in one pass, and the shaders
+ * fetch theirs from the objectData buffer texture at objectIndex. The index
+ * itself is still one glUniform1i per plain draw, which changes every time
+ * so the Program shadow never elides it. Dropping it needs a base instance
+ * or draw id (GL 4.2 / ARB_base_instance), which the GL 3.3 path lacks.
+ */
+
+#pragma once
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "StreamBuffer.h"
+
+class Program;
+class Shape;
+class InstanceBatch;
+
+enum RenderPass
+{
+	PASS_OPAQUE = 0,
+	PASS_TRANSPARENT = 1
+};
+
+class RenderQueue
+{
+public:
+	// 8 texels of the objectData buffer texture per object
+	struct ObjectData
+	{
+		glm::vec4 M[4];
+		glm::vec4 N[3]; // normal matrix columns
+		glm::vec4 params; // x = material
+	};
+
+	RenderQueue();
+	~RenderQueue();
+
+	// start a frame, V and the far plane are used to compute sort depths
+	void begin(const glm::mat4 &V, float farPlane);
+	// optional, after begin(): lets execute() cull the meshlets of shapes that have them
+	void setProjection(const glm::mat4 &P);
+	// projected diameter of a world space sphere as a fraction of the viewport
+	// height, large when there is no projection or the camera is inside
+	float getScreenSize(const glm::vec3 &center, float radius) const;
+	// lod > 0 draws that level of the shape's LOD chain
+	void submit(Program *prog, const Shape *shape, const glm::mat4 &M, int material = 0, RenderPass pass = PASS_OPAQUE, int lod = 0);
+	// one instanced draw of every instance in the batch (prog should read the instance attributes)
+	void submitInstanced(Program *prog, const Shape *shape, InstanceBatch *batch, int material = 0, RenderPass pass = PASS_OPAQUE);
+	void execute();
+
+	// counts of the last execute()
+	int getProgramBinds() const { return programBinds; }
+	int getVAOBinds() const { return vaoBinds; }
+	int getDraws() const { return draws; }
+	int getInstances() const { return instances; } // drawn by instanced draws
+	float getStreamTime() const { return streamTime; } // ms spent writing object data
+	int getTriangles() const { return triangles; } // drawn by plain draws
+	// triangles of meshlet shapes drawn / submitted, see Shape::meshletCulling
+	int getMeshletTriangles() const { return meshletTriangles; }
+	int getMeshletTrianglesTotal() const { return meshletTrianglesTotal; }
+	bool isStreamPersistent() const { return objectStream.isPersistent(); }
+
+private:
+	struct Command
+	{
+		uint64_t key;
+		uint32_t index; // into shapes/transforms
+	};
+
+	void writeObjects();
+	void push(Program *prog, const Shape *shape, const glm::mat4 &M, InstanceBatch *batch, float depth, int material, RenderPass pass, int lod);
+	static void radixSort(std::vector<Command> &commands, std::vector<Command> &scratch);
+
+	// small stable ids for the key, assigned on first use
+	int programIndex(Program *prog);
+	int meshIndex(const Shape *shape);
+
+	glm::mat4 view;
+	float farPlane;
+	glm::mat4 viewProjection;
+	glm::vec3 eye;
+	float projectionScale; // P[1][1]
+	bool hasProjection;
+
+	std::vector<Command> commands;
+	std::vector<Command> scratch;
+	std::vector<const Shape *> shapes;
+	std::vector<glm::mat4> transforms;
+	std::vector<InstanceBatch *> batches; // NULL for plain draws
+	std::vector<int> lods;
+	int numPlain;
+
+	StreamBuffer objectStream;
+	GLuint objectTexture;
+	GLuint objectTextureSource; // buffer objectTexture was last attached to
+	int objectBase; // objectIndex of the first object this frame
+
+	std::vector<Program *> programs;
+	std::unordered_map<const Shape *, int> meshIDs;
+
+	int programBinds;
+	int vaoBinds;
+	int draws;
+	int instances;
+	float streamTime;
+	int triangles;
+	int meshletTriangles;
+	int meshletTrianglesTotal;
+};
+
+#endif // RENDERQUEUE_H
@@ -29,6 +29,11 @@ void ShaderManager::initShaders() {
     shaderMap[HANDPROG] = initHandProgShader();
     shaderMap[EYEPROG] = initEyeProgShader();
     shaderMap[PUPILPROG] = initPupilProgShader();
+    shaderMap[EYEINSTPROG] = initEyeInstProgShader();
+    shaderMap[PUPILINSTPROG] = initPupilInstProgShader();
+    shaderMap[IMPOSTORBAKEPROG] = initImpostorBakeProgShader();
+    shaderMap[IMPOSTORPROG] = initImpostorProgShader();
+    shaderMap[SPHEREPROG] = initSphereProgShader();
 }
 
 shared_ptr<Program> ShaderManager::initSimpleProgShader() {
@@ -44,13 +49,6 @@ shared_ptr<Program> ShaderManager::initSimpleProgShader() {
         exit(1);
     }
     
-    prog->addUniform("P");
-    prog->addUniform("V");
-    prog->addUniform("M");
-    prog->addAttribute("vertPos");
-    prog->addAttribute("vertNor");
-    prog->addAttribute("vertTex");
-    
     return prog;
 }
 
@@ -67,13 +65,6 @@ shared_ptr<Program> ShaderManager::initSpiderProgShader() {
         exit(1);
     }
     
-    prog->addUniform("P");
-    prog->addUniform("V");
-    prog->addUniform("M");
-    prog->addAttribute("vertPos");
-    prog->addAttribute("vertNor");
-    prog->addAttribute("vertTex");
-    
     return prog;
 }
 
@@ -90,13 +81,6 @@ shared_ptr<Program> ShaderManager::initPupilProgShader() {
         exit(1);
     }
     
-    prog->addUniform("P");
-    prog->addUniform("V");
-    prog->addUniform("M");
-    prog->addAttribute("vertPos");
-    prog->addAttribute("vertNor");
-    prog->addAttribute("vertTex");
-    
     return prog;
 }
 
@@ -113,13 +97,6 @@ shared_ptr<Program> ShaderManager::initEyeProgShader() {
         exit(1);
     }
     
-    prog->addUniform("P");
-    prog->addUniform("V");
-    prog->addUniform("M");
-    prog->addAttribute("vertPos");
-    prog->addAttribute("vertNor");
-    prog->addAttribute("vertTex");
-    
     return prog;
 }
 
@@ -136,12 +113,85 @@ shared_ptr<Program> ShaderManager::initHandProgShader() {
         exit(1);
     }
     
-    prog->addUniform("P");
-    prog->addUniform("V");
-    prog->addUniform("M");
-    prog->addAttribute("vertPos");
-    prog->addAttribute("vertNor");
-    prog->addAttribute("vertTex");
+    return prog;
+}
+
+shared_ptr<Program> ShaderManager::initEyeInstProgShader() {
+//    // Initialize the GLSL program.
+    std::shared_ptr<Program> prog = make_shared<Program>();
+    
+    prog->setVerbose(true);
+    prog->setShaderNames(resourceDirectory + "/shaders/instanced_vert.glsl", resourceDirectory + "/shaders/eye_frag.glsl");
+    
+    if (!prog->init())
+    {
+        cerr << "One or more shaders failed to compile... exiting!" << endl;
+        exit(1);
+    }
+    
+    return prog;
+}
+
+shared_ptr<Program> ShaderManager::initPupilInstProgShader() {
+//    // Initialize the GLSL program.
+    std::shared_ptr<Program> prog = make_shared<Program>();
+    
+    prog->setVerbose(true);
+    prog->setShaderNames(resourceDirectory + "/shaders/instanced_vert.glsl", resourceDirectory + "/shaders/pupil_frag.glsl");
+    
+    if (!prog->init())
+    {
+        cerr << "One or more shaders failed to compile... exiting!" << endl;
+        exit(1);
+    }
+    
+    return prog;
+}
+
+shared_ptr<Program> ShaderManager::initImpostorBakeProgShader() {
+//    // Initialize the GLSL program.
+    std::shared_ptr<Program> prog = make_shared<Program>();
+    
+    prog->setVerbose(true);
+    prog->setShaderNames(resourceDirectory + "/shaders/impostor_bake_vert.glsl", resourceDirectory + "/shaders/impostor_bake_frag.glsl");
+    
+    if (!prog->init())
+    {
+        cerr << "One or more shaders failed to compile... exiting!" << endl;
+        exit(1);
+    }
+    
+    return prog;
+}
+
+shared_ptr<Program> ShaderManager::initImpostorProgShader() {
+//    // Initialize the GLSL program.
+    std::shared_ptr<Program> prog = make_shared<Program>();
+    
+    prog->setVerbose(true);
+    prog->setShaderNames(resourceDirectory + "/shaders/impostor_vert.glsl", resourceDirectory + "/shaders/impostor_frag.glsl");
+    
+    if (!prog->init())
+    {
+        cerr << "One or more shaders failed to compile... exiting!" << endl;
+        exit(1);
+    }
+    
+    return prog;
+}
+
+shared_ptr<Program> ShaderManager::initSphereProgShader() {
+//    // Initialize the GLSL program.
+    std::shared_ptr<Program> prog = make_shared<Program>();
+    
+    prog->setVerbose(true);
+    prog->setShaderNames(resourceDirectory + "/shaders/sphere_vert.glsl", resourceDirectory + "/shaders/sphere_frag.glsl");
+    
+    if (!prog->init())
+    {
+        cerr << "One or more shaders failed to compile... exiting!" << endl;
+        exit(1);
+    }
     
     return prog;
 }
@@ -38,6 +38,11 @@
 #define EYEPROG 4
 #define HANDPROG 5
 #define PUPILPROG 6
+#define EYEINSTPROG 7
+#define PUPILINSTPROG 8
+#define IMPOSTORBAKEPROG 9
+#define IMPOSTORPROG 10
+#define SPHEREPROG 11
 
 #include <memory>
 
@@ -62,6 +67,11 @@ public:
     shared_ptr<Program> initSpiderProgShader();
     shared_ptr<Program> initEyeProgShader();
     shared_ptr<Program> initPupilProgShader();
+    shared_ptr<Program> initEyeInstProgShader();
+    shared_ptr<Program> initPupilInstProgShader();
+    shared_ptr<Program> initImpostorBakeProgShader();
+    shared_ptr<Program> initImpostorProgShader();
+    shared_ptr<Program> initSphereProgShader();
     
     shared_ptr<Program> getCurrentShader() { return currentShader; }
     void setCurrentShader(int shader) { currentShader = shaderMap[shader]; }
@@ -2,9 +2,21 @@
 #include <iostream>
 #include <assert.h>
 #include <unordered_set>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <cfloat>
+#include <chrono>
+
+#include <glm/glm.hpp>
 
 #include "GLSL.h"
+#include "GLState.h"
 #include "Program.h"
+#include "MeshBVH.h"
+#include "FrustumCuller.h"
+#include "MeshSimplifier.h"
+#include "AOBaker.h"
 
 using namespace std;
 using namespace glm;
@@ -51,6 +63,15 @@ int Shape::getNumEdges()
 	return (int)(edgeBuffer.size() / 2);
 }
 
+const MeshBVH &Shape::getBVH()
+{
+	if (bvh == nullptr)
+	{
+		bvh = make_shared<MeshBVH>(posBuf, eleBuf);
+	}
+	return *bvh;
+}
+
 typedef pair<unsigned int, unsigned int> vert_pair;
 struct pair_hash
 {
@@ -257,8 +278,17 @@ Shape::Shape() :
 	eleBufID(0),
 	posBufID(0),
 	norBufID(0),
-	texBufID(0), 
-   vaoID(0)
+	texBufID(0),
+	vertBufID(0),
+	decodeBufID(0),
+	aoBufID(0),
+	vaoID(0),
+	instanceBufID(0),
+	indexType(GL_UNSIGNED_INT),
+	gpuMemory(0),
+	aoBakeTime(0),
+	compact(false),
+	meshletsBuilt(false)
 {
 	min = glm::vec3(0);
 	max = glm::vec3(0);
@@ -266,6 +296,107 @@ Shape::Shape() :
 
 Shape::~Shape()
 {
+	// only init()'ed shapes own GL objects
+	if (vaoID != 0)
+	{
+		unsigned buffers[] = {posBufID, norBufID, texBufID, vertBufID, decodeBufID, aoBufID, eleBufID};
+		for (unsigned buffer : buffers)
+		{
+			if (buffer != 0)
+			{
+				GLState::deleteBuffer(buffer);
+			}
+		}
+		GLState::deleteVertexArray(vaoID);
+		gpuMemoryTotal -= gpuMemory;
+	}
+}
+
+size_t Shape::getCPUMemory() const
+{
+	return (posBuf.size() + norBuf.size() + texBuf.size() + uvBuffer.size()) * sizeof(float) +
+		(eleBuf.size() + lodBuf.size() + edgeBuffer.size()) * sizeof(unsigned int) + aoBuf.size();
+}
+
+shared_ptr<Shape> Shape::merge(const vector<shared_ptr<Shape>> &parts)
+{
+	shared_ptr<Shape> merged = make_shared<Shape>();
+	bool anyNor = false, anyTex = false, anyAO = false;
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		anyNor = anyNor || !parts[i]->norBuf.empty();
+		anyTex = anyTex || !parts[i]->texBuf.empty();
+		anyAO = anyAO || parts[i]->hasAO();
+	}
+
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		const Shape &part = *parts[i];
+		unsigned int base = (unsigned int)(merged->posBuf.size() / 3);
+		int numVerts = (int)(part.posBuf.size() / 3);
+
+		for (int v = 0; v < numVerts; v++)
+		{
+			merged->posBuf.insert(merged->posBuf.end(),
+				{part.posBuf[v * 3], part.posBuf[v * 3 + 1], part.posBuf[v * 3 + 2]});
+			if (anyNor)
+			{
+				bool has = part.norBuf.size() >= part.posBuf.size();
+				merged->norBuf.insert(merged->norBuf.end(),
+					{has ? part.norBuf[v * 3] : 0.0f, has ? part.norBuf[v * 3 + 1] : 0.0f, has ? part.norBuf[v * 3 + 2] : 0.0f});
+			}
+			if (anyTex)
+			{
+				bool has = part.texBuf.size() / 2 >= (size_t)numVerts;
+				merged->texBuf.push_back(has ? part.texBuf[v * 2] : 0.0f);
+				merged->texBuf.push_back(has ? part.texBuf[v * 2 + 1] : 0.0f);
+			}
+			if (anyAO)
+			{
+				merged->aoBuf.push_back(part.hasAO() ? part.aoBuf[v] : 255);
+			}
+		}
+
+		SubRange range;
+		range.first = (int)merged->eleBuf.size();
+		range.count = (int)part.eleBuf.size();
+		merged->ranges.push_back(range);
+		for (size_t e = 0; e < part.eleBuf.size(); e++)
+		{
+			merged->eleBuf.push_back(base + part.eleBuf[e]);
+		}
+	}
+
+	merged->measure();
+	merged->init();
+	return merged;
+}
+
+// unitQuad(), released by releaseUnitQuad() rather than at static destruction
+static shared_ptr<Shape> sharedQuad;
+
+const shared_ptr<Shape> &Shape::unitQuad()
+{
+	if (sharedQuad == nullptr)
+	{
+		float positions[] = {-1, -1, 0, 1, -1, 0, 1, 1, 0, -1, 1, 0};
+		float normals[] = {0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1};
+		float texcoords[] = {0, 0, 1, 0, 1, 1, 0, 1};
+		unsigned int indices[] = {0, 1, 2, 0, 2, 3};
+		sharedQuad = make_shared<Shape>();
+		sharedQuad->posBuf.assign(positions, positions + 12);
+		sharedQuad->norBuf.assign(normals, normals + 12);
+		sharedQuad->texBuf.assign(texcoords, texcoords + 8);
+		sharedQuad->eleBuf.assign(indices, indices + 6);
+		sharedQuad->measure();
+		sharedQuad->init();
+	}
+	return sharedQuad;
+}
+
+void Shape::releaseUnitQuad()
+{
+	sharedQuad.reset();
 }
 
 /* copy the data from the shape to this object */
@@ -277,24 +408,190 @@ void Shape::createShape(tinyobj::shape_t & shape)
 		eleBuf = shape.mesh.indices;
 }
 
+bool Shape::compactVertices = false;
+size_t Shape::gpuMemoryTotal = 0;
+bool Shape::meshletCulling = false;
+bool Shape::overdrawOrder = false;
+
+// smaller meshes (or parts) are drawn whole, culling them isn't worth a draw range
+static const int MESHLET_MIN_TRIANGLES = 512;
+
+// LOD levels 1.., as fractions of the full triangle count
+static const float LOD_RATIOS[] = {0.5f, 0.25f, 0.1f};
+static const int LOD_MIN_TRIANGLES = 256;
+
+// Vertex of the compact format, 16 bytes instead of 32
+struct CompactVertex
+{
+	uint16_t pos[4]; // unorm16 within the mesh bounds, w unused
+	int16_t nor[2]; // snorm16 octahedral
+	uint16_t tex[2]; // half float
+};
+
+static uint16_t floatToHalf(float f)
+{
+	uint32_t x;
+	memcpy(&x, &f, sizeof(x));
+	uint32_t sign = (x >> 16) & 0x8000;
+	int exp = (int)((x >> 23) & 0xff) - 127 + 15;
+	uint32_t mant = x & 0x7fffff;
+	if (exp >= 31)
+	{
+		return (uint16_t)(sign | 0x7c00);
+	}
+	if (exp <= 0)
+	{
+		// subnormal half
+		if (exp < -10)
+		{
+			return (uint16_t)sign;
+		}
+		mant |= 0x800000;
+		uint32_t shift = 14 - exp;
+		uint32_t h = mant >> shift;
+		if ((mant >> (shift - 1)) & 1)
+		{
+			h++;
+		}
+		return (uint16_t)(sign | h);
+	}
+	// rounding may carry into the exponent, which is still the right result
+	uint32_t h = sign | ((uint32_t)exp << 10) | (mant >> 13);
+	if (mant & 0x1000)
+	{
+		h++;
+	}
+	return (uint16_t)h;
+}
+
+// Maps a unit vector onto the [-1, 1] square (decoded in the vertex shaders)
+static vec2 octEncode(vec3 n)
+{
+	float l1 = fabs(n.x) + fabs(n.y) + fabs(n.z);
+	if (l1 == 0)
+	{
+		return vec2(0);
+	}
+	n /= l1;
+	vec2 e(n.x, n.y);
+	if (n.z < 0)
+	{
+		e = (vec2(1) - abs(vec2(e.y, e.x))) * vec2(e.x >= 0 ? 1.0f : -1.0f, e.y >= 0 ? 1.0f : -1.0f);
+	}
+	return e;
+}
+
+static int16_t toSnorm16(float v)
+{
+	return (int16_t)round(clamp(v, -1.0f, 1.0f) * 32767.0f);
+}
+
 void Shape::init()
 {
-   // Initialize the vertex array object
-   glGenVertexArrays(1, &vaoID);
-   glBindVertexArray(vaoID);
+	compact = compactVertices;
+	gpuMemory = 0;
+
+	// reorders eleBuf, so it has to happen before the upload
+	if (!meshletsBuilt)
+	{
+		buildMeshlets();
+	}
+
+	// Initialize the vertex array object. Everything below is recorded in it,
+	// so draw() only has to bind it.
+	glGenVertexArrays(1, &vaoID);
+	GLState::bindVertexArray(vaoID);
+
+	// decode[0] = position bias, w = 1 with an AO stream, decode[1] =
+	// position scale, w = 1 when the normals are octahedral
+	vec4 decode[2];
+	if (compact)
+	{
+		initCompact(decode);
+	}
+	else
+	{
+		initFloat(decode);
+	}
+
+	// baked ambient occlusion, decode[0].w = 1 tells the shaders it's there
+	if (!aoBuf.empty())
+	{
+		glGenBuffers(1, &aoBufID);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, aoBufID);
+		glBufferData(GL_ARRAY_BUFFER, aoBuf.size(), &aoBuf[0], GL_STATIC_DRAW);
+		glEnableVertexAttribArray(GLSL::ATTRIB_AO);
+		glVertexAttribPointer(GLSL::ATTRIB_AO, 1, GL_UNSIGNED_BYTE, GL_TRUE, 0, (const void *)0);
+		gpuMemory += aoBuf.size();
+		decode[0].w = 1;
+	}
+
+	// The decode constants are a two element attribute stream with a divisor
+	// no instance count reaches, so every vertex and instance reads element 0
+	glGenBuffers(1, &decodeBufID);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, decodeBufID);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(decode), decode, GL_STATIC_DRAW);
+	for (int i = 0; i < 2; i++)
+	{
+		glEnableVertexAttribArray(GLSL::ATTRIB_DECODE_BIAS + i);
+		glVertexAttribPointer(GLSL::ATTRIB_DECODE_BIAS + i, 4, GL_FLOAT, GL_FALSE, 0, (const void *)(i * sizeof(vec4)));
+		glVertexAttribDivisor(GLSL::ATTRIB_DECODE_BIAS + i, 0xffffffffu);
+	}
+	gpuMemory += sizeof(decode);
+
+	// Send the element array to the GPU (the binding is part of the VAO),
+	// followed by the LOD levels
+	vector<unsigned int> indices(eleBuf);
+	indices.insert(indices.end(), lodBuf.begin(), lodBuf.end());
+	glGenBuffers(1, &eleBufID);
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, eleBufID);
+	if (compact && getNumVertices() < 65536)
+	{
+		vector<uint16_t> shortBuf(indices.begin(), indices.end());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortBuf.size()*sizeof(uint16_t), &shortBuf[0], GL_STATIC_DRAW);
+		indexType = GL_UNSIGNED_SHORT;
+		gpuMemory += shortBuf.size()*sizeof(uint16_t);
+	}
+	else
+	{
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+		indexType = GL_UNSIGNED_INT;
+		gpuMemory += indices.size()*sizeof(unsigned int);
+	}
+	
+	// Unbind the VAO before the arrays, or it would forget the element buffer
+	GLState::bindVertexArray(0);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	gpuMemoryTotal += gpuMemory;
+	
+	assert(glGetError() == GL_NO_ERROR);
+}
+
+void Shape::initFloat(vec4 decode[2])
+{
+	decode[0] = vec4(0);
+	decode[1] = vec4(1, 1, 1, 0);
 
 	// Send the position array to the GPU
 	glGenBuffers(1, &posBufID);
-	glBindBuffer(GL_ARRAY_BUFFER, posBufID);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, posBufID);
 	glBufferData(GL_ARRAY_BUFFER, posBuf.size()*sizeof(float), &posBuf[0], GL_STATIC_DRAW);
+	glEnableVertexAttribArray(GLSL::ATTRIB_POS);
+	glVertexAttribPointer(GLSL::ATTRIB_POS, 3, GL_FLOAT, GL_FALSE, 0, (const void *)0);
+	gpuMemory += posBuf.size()*sizeof(float);
 	
 	// Send the normal array to the GPU
 	if(norBuf.empty()) {
 		norBufID = 0;
 	} else {
 		glGenBuffers(1, &norBufID);
-		glBindBuffer(GL_ARRAY_BUFFER, norBufID);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, norBufID);
 		glBufferData(GL_ARRAY_BUFFER, norBuf.size()*sizeof(float), &norBuf[0], GL_STATIC_DRAW);
+		glEnableVertexAttribArray(GLSL::ATTRIB_NOR);
+		glVertexAttribPointer(GLSL::ATTRIB_NOR, 3, GL_FLOAT, GL_FALSE, 0, (const void *)0);
+		gpuMemory += norBuf.size()*sizeof(float);
 	}
 	
 	// Send the texture array to the GPU
@@ -302,66 +599,316 @@ void Shape::init()
 		texBufID = 0;
 	} else {
 		glGenBuffers(1, &texBufID);
-		glBindBuffer(GL_ARRAY_BUFFER, texBufID);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, texBufID);
 		glBufferData(GL_ARRAY_BUFFER, texBuf.size()*sizeof(float), &texBuf[0], GL_STATIC_DRAW);
+		glEnableVertexAttribArray(GLSL::ATTRIB_TEX);
+		glVertexAttribPointer(GLSL::ATTRIB_TEX, 2, GL_FLOAT, GL_FALSE, 0, (const void *)0);
+		gpuMemory += texBuf.size()*sizeof(float);
 	}
-	
-	// Send the element array to the GPU
-	glGenBuffers(1, &eleBufID);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eleBufID);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, eleBuf.size()*sizeof(unsigned int), &eleBuf[0], GL_STATIC_DRAW);
-	
-	// Unbind the arrays
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	
-	assert(glGetError() == GL_NO_ERROR);
 }
 
+void Shape::initCompact(vec4 decode[2])
+{
+	int numVerts = getNumVertices();
+
+	vec3 lo(1.1754E+38F), hi(-1.1754E+38F);
+	for (int v = 0; v < numVerts; v++)
+	{
+		vec3 p(posBuf[v * 3], posBuf[v * 3 + 1], posBuf[v * 3 + 2]);
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+	vec3 extent = numVerts ? hi - lo : vec3(0);
+	vec3 quantize;
+	for (int i = 0; i < 3; i++)
+	{
+		quantize[i] = extent[i] > 0 ? 65535.0f / extent[i] : 0.0f;
+	}
+	decode[0] = vec4(numVerts ? lo : vec3(0), 0);
+	decode[1] = vec4(extent, 1);
+
+	bool hasNor = norBuf.size() >= posBuf.size();
+	bool hasTex = texBuf.size() / 2 >= (size_t)numVerts;
+	vector<CompactVertex> verts(numVerts);
+	for (int v = 0; v < numVerts; v++)
+	{
+		CompactVertex &cv = verts[v];
+		for (int i = 0; i < 3; i++)
+		{
+			cv.pos[i] = (uint16_t)clamp(round((posBuf[v * 3 + i] - lo[i]) * quantize[i]), 0.0f, 65535.0f);
+		}
+		cv.pos[3] = 65535;
+
+		vec2 oct = hasNor ? octEncode(vec3(norBuf[v * 3], norBuf[v * 3 + 1], norBuf[v * 3 + 2])) : vec2(0);
+		cv.nor[0] = toSnorm16(oct.x);
+		cv.nor[1] = toSnorm16(oct.y);
+
+		cv.tex[0] = floatToHalf(hasTex ? texBuf[v * 2] : 0.0f);
+		cv.tex[1] = floatToHalf(hasTex ? texBuf[v * 2 + 1] : 0.0f);
+	}
+
+	glGenBuffers(1, &vertBufID);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, vertBufID);
+	glBufferData(GL_ARRAY_BUFFER, verts.size()*sizeof(CompactVertex), verts.empty() ? NULL : &verts[0], GL_STATIC_DRAW);
+	gpuMemory += verts.size()*sizeof(CompactVertex);
+
+	const GLsizei stride = sizeof(CompactVertex);
+	glEnableVertexAttribArray(GLSL::ATTRIB_POS);
+	glVertexAttribPointer(GLSL::ATTRIB_POS, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride, (const void *)offsetof(CompactVertex, pos));
+	glEnableVertexAttribArray(GLSL::ATTRIB_NOR);
+	glVertexAttribPointer(GLSL::ATTRIB_NOR, 2, GL_SHORT, GL_TRUE, stride, (const void *)offsetof(CompactVertex, nor));
+	glEnableVertexAttribArray(GLSL::ATTRIB_TEX);
+	glVertexAttribPointer(GLSL::ATTRIB_TEX, 2, GL_HALF_FLOAT, GL_FALSE, stride, (const void *)offsetof(CompactVertex, tex));
+}
+
+// The program's attributes are expected at the GLSL::AttribLocation slots
 void Shape::draw(const shared_ptr<Program> prog) const
 {
-	int h_pos, h_nor, h_tex;
-	h_pos = h_nor = h_tex = -1;
+	bind();
+	drawElements();
+}
+
+void Shape::bind() const
+{
+	GLState::bindVertexArray(vaoID);
+}
 
-   glBindVertexArray(vaoID);
-	// Bind position buffer
-	h_pos = prog->getAttribute("vertPos");
-	GLSL::enableVertexAttribArray(h_pos);
-	glBindBuffer(GL_ARRAY_BUFFER, posBufID);
-	glVertexAttribPointer(h_pos, 3, GL_FLOAT, GL_FALSE, 0, (const void *)0);
-	
-	// Bind normal buffer
-	h_nor = prog->getAttribute("vertNor");
-	if(h_nor != -1 && norBufID != 0) {
-		GLSL::enableVertexAttribArray(h_nor);
-		glBindBuffer(GL_ARRAY_BUFFER, norBufID);
-		glVertexAttribPointer(h_nor, 3, GL_FLOAT, GL_FALSE, 0, (const void *)0);
-	}
-
-	if (texBufID != 0) {	
-		// Bind texcoords buffer
-		h_tex = prog->getAttribute("vertTex");
-		if(h_tex != -1 && texBufID != 0) {
-			GLSL::enableVertexAttribArray(h_tex);
-			glBindBuffer(GL_ARRAY_BUFFER, texBufID);
-			glVertexAttribPointer(h_tex, 2, GL_FLOAT, GL_FALSE, 0, (const void *)0);
+void Shape::drawElements() const
+{
+	glDrawElements(GL_TRIANGLES, (int)eleBuf.size(), indexType, (const void *)0);
+}
+
+void Shape::multiDraw(const vector<SubRange> &draw) const
+{
+	size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+	vector<GLsizei> counts;
+	vector<const void *> offsets;
+	for (size_t i = 0; i < draw.size(); i++)
+	{
+		counts.push_back(draw[i].count);
+		offsets.push_back((const void *)(draw[i].first * indexSize));
+	}
+	if (!counts.empty())
+	{
+		glMultiDrawElements(GL_TRIANGLES, &counts[0], indexType, &offsets[0], (GLsizei)counts.size());
+	}
+}
+
+void Shape::optimize(MeshOptimizer::CacheStats &before, MeshOptimizer::CacheStats &after)
+{
+	int numVerts = (int)posBuf.size() / 3;
+	int count = (int)eleBuf.size() / 3 * 3;
+	before = MeshOptimizer::simulateCache(eleBuf, 0, count);
+
+	MeshOptimizer::optimizeVertexCache(eleBuf, 0, count, numVerts);
+	if (overdrawOrder)
+	{
+		MeshOptimizer::optimizeOverdraw(posBuf, eleBuf, 0, count);
+	}
+
+	vector<unsigned int> remap;
+	MeshOptimizer::optimizeVertexFetch(eleBuf, numVerts, remap);
+	MeshOptimizer::remapVertices(posBuf, 3, remap);
+	MeshOptimizer::remapVertices(norBuf, 3, remap);
+	MeshOptimizer::remapVertices(texBuf, 2, remap);
+
+	after = MeshOptimizer::simulateCache(eleBuf, 0, count);
+}
+
+void Shape::buildLODs()
+{
+	lods.clear();
+	lodBuf.clear();
+	int full = (int)eleBuf.size() / 3;
+	if (full < LOD_MIN_TRIANGLES)
+	{
+		return;
+	}
+
+	// each level is simplified from the one before, which is much smaller
+	vector<unsigned int> previous = eleBuf;
+	vector<unsigned int> level;
+	for (float ratio : LOD_RATIOS)
+	{
+		int triangles = MeshSimplifier::simplify(posBuf, previous, (int)(full * ratio), level);
+		MeshOptimizer::optimizeVertexCache(level, 0, (int)level.size(), (int)posBuf.size() / 3);
+		// stop once simplification stalls (mostly locked border vertices)
+		if (triangles > (int)previous.size() / 3 * 9 / 10)
+		{
+			break;
 		}
+		SubRange range;
+		range.first = (int)(eleBuf.size() + lodBuf.size());
+		range.count = (int)level.size();
+		lods.push_back(range);
+		lodBuf.insert(lodBuf.end(), level.begin(), level.end());
+		previous.swap(level);
 	}
-	
-	// Bind element buffer
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eleBufID);
-	
-	// Draw
-	glDrawElements(GL_TRIANGLES, (int)eleBuf.size(), GL_UNSIGNED_INT, (const void *)0);
-	
-	// Disable and unbind
-	if(h_tex != -1) {
-		GLSL::disableVertexAttribArray(h_tex);
+}
+
+void Shape::setLODs(const vector<vector<unsigned int>> &levels)
+{
+	lods.clear();
+	lodBuf.clear();
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		SubRange range;
+		range.first = (int)(eleBuf.size() + lodBuf.size());
+		range.count = (int)levels[i].size();
+		lods.push_back(range);
+		lodBuf.insert(lodBuf.end(), levels[i].begin(), levels[i].end());
+	}
+}
+
+// share of the mesh size occluders are searched within
+static const float AO_DISTANCE = 0.2f;
+
+void Shape::bakeAO(const string &cacheDir, int rays)
+{
+	aoBakeTime = 0;
+	if (norBuf.size() < posBuf.size() || eleBuf.empty())
+	{
+		return;
+	}
+	float maxDistance = length(max - min) * AO_DISTANCE;
+	uint64_t hash = AOBaker::hashMesh(posBuf, norBuf, eleBuf, rays, maxDistance);
+	string file = cacheDir.empty() ? "" : AOBaker::cacheFile(cacheDir, hash);
+	if (!file.empty() && AOBaker::load(file, posBuf.size() / 3, aoBuf))
+	{
+		return;
+	}
+
+	auto start = chrono::high_resolution_clock::now();
+	AOBaker::bake(posBuf, norBuf, getBVH(), rays, maxDistance, aoBuf);
+	aoBakeTime = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - start).count();
+	if (!file.empty() && !AOBaker::save(file, aoBuf))
+	{
+		cerr << "Could not write AO cache: '" << file << "'" << endl;
+	}
+}
+
+int Shape::getLODTriangles(int level) const
+{
+	return level <= 0 || lods.empty() ? (int)eleBuf.size() / 3 : lods[(std::min)(level, (int)lods.size()) - 1].count / 3;
+}
+
+void Shape::drawLOD(int level) const
+{
+	if (level <= 0 || lods.empty())
+	{
+		drawElements();
+		return;
 	}
-	if(h_nor != -1) {
-		GLSL::disableVertexAttribArray(h_nor);
+	const SubRange &range = lods[(std::min)(level, (int)lods.size()) - 1];
+	size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+	glDrawElements(GL_TRIANGLES, range.count, indexType, (const void *)(range.first * indexSize));
+}
+
+void Shape::buildMeshlets()
+{
+	meshlets.clear();
+	vector<SubRange> parts = ranges;
+	if (parts.empty())
+	{
+		SubRange whole;
+		whole.first = 0;
+		whole.count = (int)eleBuf.size();
+		parts.push_back(whole);
+	}
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		if (parts[i].count / 3 >= MESHLET_MIN_TRIANGLES)
+		{
+			size_t start = meshlets.size();
+			Meshlets::build(posBuf, eleBuf, parts[i].first, parts[i].count, meshlets);
+			// clustering undoes the cache order, redo it inside each meshlet
+			for (size_t m = start; m < meshlets.size(); m++)
+			{
+				MeshOptimizer::optimizeVertexCache(eleBuf, meshlets[m].first, meshlets[m].count, (int)posBuf.size() / 3);
+			}
+		}
+		else if (parts.size() > 1)
+		{
+			// small parts of a merged shape become one meshlet that is never culled
+			Meshlet meshlet;
+			meshlet.center = vec3(0);
+			meshlet.radius = FLT_MAX;
+			meshlet.coneApex = vec3(0);
+			meshlet.coneAxis = vec3(0, 0, 1);
+			meshlet.coneCutoff = 2;
+			meshlet.first = parts[i].first;
+			meshlet.count = parts[i].count;
+			meshlets.push_back(meshlet);
+		}
+	}
+	// nothing was split, drawing the whole mesh is just as good
+	bool split = false;
+	for (size_t i = 0; i < meshlets.size(); i++)
+	{
+		split = split || meshlets[i].radius != FLT_MAX;
+	}
+	if (!split)
+	{
+		meshlets.clear();
+	}
+	meshletsBuilt = true;
+	// a BVH built before numbers the triangles in the old order
+	bvh.reset();
+}
+
+int Shape::cullMeshlets(const mat4 &M, const mat4 &PV, const vec3 &eye, vector<SubRange> &visible) const
+{
+	// both tests run in the mesh's local space
+	vec4 planes[6];
+	FrustumCuller::extractPlanes(PV * M, planes);
+	vec3 localEye = vec3(inverse(M) * vec4(eye, 1));
+
+	visible.clear();
+	int triangles = 0;
+	for (size_t i = 0; i < meshlets.size(); i++)
+	{
+		const Meshlet &meshlet = meshlets[i];
+		if (Meshlets::isOutside(meshlet, planes) || Meshlets::isBackfacing(meshlet, localEye))
+		{
+			continue;
+		}
+		triangles += meshlet.count / 3;
+		if (!visible.empty() && visible.back().first + visible.back().count == meshlet.first)
+		{
+			visible.back().count += meshlet.count;
+		}
+		else
+		{
+			SubRange range;
+			range.first = meshlet.first;
+			range.count = meshlet.count;
+			visible.push_back(range);
+		}
+	}
+	return triangles;
+}
+
+int Shape::drawMeshlets(const mat4 &M, const mat4 &PV, const vec3 &eye) const
+{
+	int triangles = cullMeshlets(M, PV, eye, visibleMeshlets);
+	multiDraw(visibleMeshlets);
+	return triangles;
+}
+
+void Shape::drawInstanced(unsigned instanceBuffer, int count) const
+{
+	if (instanceBuffer != instanceBufID)
+	{
+		// InstanceBatch::Instance is a mat4 followed by a vec4
+		const GLsizei stride = sizeof(mat4) + sizeof(vec4);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		for (int i = 0; i < 5; i++)
+		{
+			glEnableVertexAttribArray(GLSL::ATTRIB_INSTANCE_M + i);
+			glVertexAttribPointer(GLSL::ATTRIB_INSTANCE_M + i, 4, GL_FLOAT, GL_FALSE, stride, (const void *)(i * sizeof(vec4)));
+			glVertexAttribDivisor(GLSL::ATTRIB_INSTANCE_M + i, 1);
+		}
+		instanceBufID = instanceBuffer;
 	}
-	GLSL::disableVertexAttribArray(h_pos);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glDrawElementsInstanced(GL_TRIANGLES, (int)eleBuf.size(), indexType, (const void *)0, count);
 }
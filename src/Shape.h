@@ -6,20 +6,93 @@
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <cstdint>
 #include <glm/gtc/type_ptr.hpp>
 #include <tiny_obj_loader/tiny_obj_loader.h>
 
+#include "Meshlets.h"
+#include "MeshOptimizer.h"
+
 class Program;
+class MeshBVH;
 
 class Shape
 {
 public:
 	Shape();
-	virtual ~Shape();
+	virtual ~Shape(); // deletes the GL buffers
+	Shape(const Shape &) = delete;
+	Shape &operator=(const Shape &) = delete;
 	void createShape(tinyobj::shape_t & shape);
 	void init();
 	void measure();
 	void draw(const std::shared_ptr<Program> prog) const;
+	// draw() split in two, so runs of the same mesh bind its VAO once
+	void bind() const;
+	void drawElements() const;
+	// after bind(): draws `count` instances, reading per-instance data from an InstanceBatch buffer
+	void drawInstanced(unsigned instanceBuffer, int count) const;
+
+	// Static batching: one shape holding every part of a model in a single
+	// vertex and index buffer, drawn with one call. Each part keeps its index
+	// range, so meshlets are built per part.
+	struct SubRange
+	{
+		int first; // first index
+		int count;
+	};
+	static std::shared_ptr<Shape> merge(const std::vector<std::shared_ptr<Shape>> &parts);
+
+	// Quad in the xy plane with corners at -1 and 1, facing +z, created on
+	// first use. Billboards (Impostor, sphere impostors) place its corners
+	// themselves in the vertex shader.
+	static const std::shared_ptr<Shape> &unitQuad();
+	// frees its buffers, call before the GL context goes away
+	static void releaseUnitQuad();
+
+	// Meshlet culling: init() clusters the triangles of larger meshes (each
+	// part of a merged shape separately). cullMeshlets() returns the index
+	// ranges of the meshlets that can be seen from `eye` (world space), with
+	// neighbouring ranges merged, and the number of triangles they hold.
+	static bool meshletCulling; // whether RenderQueue draws through drawMeshlets()
+	bool hasMeshlets() const { return !meshlets.empty(); }
+	const std::vector<Meshlet> &getMeshlets() const { return meshlets; }
+	int cullMeshlets(const glm::mat4 &M, const glm::mat4 &PV, const glm::vec3 &eye, std::vector<SubRange> &visible) const;
+	// after bind(): draws what cullMeshlets() keeps, returns the triangles drawn
+	int drawMeshlets(const glm::mat4 &M, const glm::mat4 &PV, const glm::vec3 &eye) const;
+
+	// LOD chain: buildLODs() simplifies the mesh to 50%, 25% and 10% of its
+	// triangles (as far as that goes) over the same vertices. It only touches
+	// CPU data, so shapes can build theirs in parallel before init() uploads
+	// the levels behind the full index buffer. Level 0 is the full mesh.
+	void buildLODs();
+	// or takes levels 1.. made along with the mesh (see Primitives), as index
+	// lists over its vertices
+	void setLODs(const std::vector<std::vector<unsigned int>> &levels);
+
+	// Reorders triangles for the post-transform cache (and, with
+	// overdrawOrder, for front to back runs) and vertices for fetch
+	// locality. Call right after createShape(); the cache statistics before
+	// and after go into the arguments.
+	void optimize(MeshOptimizer::CacheStats &before, MeshOptimizer::CacheStats &after);
+	static bool overdrawOrder;
+
+	// Clusters the triangles into meshlets, which reorders them. CPU only
+	// like buildLODs(); init() does it for shapes that skipped it. Call it
+	// before getBVH(), whose triangle numbers follow the index order.
+	void buildMeshlets();
+
+	// Bakes per-vertex ambient occlusion (see AOBaker) on the worker pool,
+	// or reads it from cacheDir if this geometry was baked before. An empty
+	// cacheDir bakes without caching. Call after optimize() and before
+	// init(), which uploads it as the GLSL::ATTRIB_AO stream.
+	void bakeAO(const std::string &cacheDir, int rays = 64);
+	bool hasAO() const { return !aoBuf.empty(); }
+	float getAOBakeTime() const { return aoBakeTime; } // milliseconds, 0 when it came from the cache
+	int getNumLODs() const { return (int)lods.size() + 1; }
+	int getLODTriangles(int level) const;
+	// after bind()
+	void drawLOD(int level) const;
 	glm::vec3 min;
 	glm::vec3 max;
 	glm::vec3 center;
@@ -35,20 +108,53 @@ public:
 	int getNumVertices();
 	std::vector<glm::vec3> getEdge(int i, const glm::mat4 &M);
 	int getNumEdges();
+	const std::vector<float> &getPositions() const { return posBuf; }
+	const std::vector<unsigned int> &getIndices() const { return eleBuf; }
+	const MeshBVH &getBVH(); // triangle BVH in local space, built on first use (MeshCache builds it at load)
 	std::vector<unsigned int> edgeBuffer;
+
+	// Upload shapes init()'ed from now on with the compact vertex format:
+	// one interleaved stream of 16 byte vertices (positions quantized to the
+	// mesh bounds, octahedral normals, half float texcoords) and 16-bit
+	// indices when the mesh has fewer than 65536 vertices.
+	static bool compactVertices;
+	static size_t gpuMemoryTotal; // bytes in the buffers of every initialized shape
+	size_t getGPUMemory() const { return gpuMemory; }
+	size_t getCPUMemory() const; // bytes of the vertex, index and edge arrays
+	bool isCompact() const { return compact; }
 	
 private:
+	void initFloat(glm::vec4 decode[2]);
+	void initCompact(glm::vec4 decode[2]);
+	void multiDraw(const std::vector<SubRange> &draw) const;
+
 	std::vector<unsigned int> eleBuf;
 	std::vector<float> posBuf;
 	std::vector<float> norBuf;
 	std::vector<float> texBuf;
 	std::vector<float> uvBuffer;
+	std::vector<SubRange> ranges; // parts of a merged shape
+	std::vector<Meshlet> meshlets;
+	std::vector<uint8_t> aoBuf; // unorm8 per vertex
+	std::vector<unsigned int> lodBuf; // indices of every LOD level, uploaded after eleBuf
+	std::vector<SubRange> lods; // level i + 1, offsets into the uploaded index buffer
+	mutable std::vector<SubRange> visibleMeshlets; // scratch for drawMeshlets()
 	unsigned int uvBufferID = 0;
+	std::shared_ptr<MeshBVH> bvh;
 	unsigned eleBufID;
 	unsigned posBufID;
 	unsigned norBufID;
 	unsigned texBufID;
-   unsigned vaoID;
+	unsigned vertBufID; // interleaved stream of the compact format
+	unsigned decodeBufID;
+	unsigned aoBufID;
+	unsigned vaoID;
+	mutable unsigned instanceBufID; // instance buffer the VAO's instance attributes point at
+	unsigned indexType;
+	size_t gpuMemory;
+	float aoBakeTime;
+	bool compact;
+	bool meshletsBuilt;
 };
 
 #endif
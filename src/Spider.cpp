@@ -111,7 +111,8 @@ void Spider::drawPart(shared_ptr<Program> prog, shared_ptr<MatrixStack> M, vec3
 {
 	M->pushMatrix();
 	M->scale(scale);
-	glUniformMatrix4fv(prog->getUniform("M"), 1, GL_FALSE, value_ptr(M->topMatrix()));
+	static const int uM = Program::getUniformID("M");
+	prog->setUniform(uM, M->topMatrix());
 	sphere->draw(prog);
 	M->popMatrix();
 }
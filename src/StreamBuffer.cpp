@@ -0,0 +1,145 @@
+#include "StreamBuffer.h"
+
+#include <cassert>
+#include <GLFW/glfw3.h>
+
+#include "GLSL.h"
+#include "GLState.h"
+
+// ARB_buffer_storage isn't in our GL 3.3 loader, fetch it by hand
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+static BufferStorageProc getBufferStorage()
+{
+	static bool loaded = false;
+	static BufferStorageProc proc = NULL;
+	if (!loaded)
+	{
+		loaded = true;
+		if (glfwExtensionSupported("GL_ARB_buffer_storage"))
+		{
+			proc = (BufferStorageProc)glfwGetProcAddress("glBufferStorage");
+		}
+	}
+	return proc;
+}
+
+StreamBuffer::StreamBuffer() :
+	bufferID(0),
+	regionSize(0),
+	region(0),
+	mapped(NULL)
+{
+	for (int i = 0; i < FRAMES; i++)
+	{
+		fences[i] = 0;
+	}
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	release();
+}
+
+void StreamBuffer::release()
+{
+	for (int i = 0; i < FRAMES; i++)
+	{
+		if (fences[i] != 0)
+		{
+			glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+	}
+	if (bufferID != 0)
+	{
+		if (mapped != NULL)
+		{
+			GLState::bindBuffer(GL_ARRAY_BUFFER, bufferID);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			mapped = NULL;
+		}
+		GLState::deleteBuffer(bufferID);
+		bufferID = 0;
+	}
+}
+
+void StreamBuffer::allocate(size_t bytes)
+{
+	// the old storage may still be in use
+	glFinish();
+	release();
+
+	regionSize = bytes;
+	glGenBuffers(1, &bufferID);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, bufferID);
+
+	BufferStorageProc bufferStorage = getBufferStorage();
+	if (bufferStorage != NULL)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		bufferStorage(GL_ARRAY_BUFFER, regionSize * FRAMES, NULL, flags);
+		mapped = (char *)glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize * FRAMES, flags);
+	}
+	if (mapped == NULL)
+	{
+		// orphaning: one region is enough, the driver renames the storage
+		glBufferData(GL_ARRAY_BUFFER, regionSize, NULL, GL_STREAM_DRAW);
+		staging.resize(regionSize);
+	}
+	assert(glGetError() == GL_NO_ERROR);
+}
+
+void *StreamBuffer::begin(size_t bytes)
+{
+	if (bufferID == 0 || bytes > regionSize)
+	{
+		size_t size = regionSize ? regionSize : 64 * 1024;
+		while (size < bytes)
+		{
+			size *= 2;
+		}
+		allocate(size);
+	}
+	if (mapped == NULL)
+	{
+		return &staging[0];
+	}
+
+	region = (region + 1) % FRAMES;
+	if (fences[region] != 0)
+	{
+		// normally long signaled, the GPU is at most FRAMES - 1 frames behind
+		while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+		{
+		}
+		glDeleteSync(fences[region]);
+		fences[region] = 0;
+	}
+	return mapped + region * regionSize;
+}
+
+size_t StreamBuffer::commit(size_t bytes)
+{
+	if (mapped != NULL)
+	{
+		// coherent mapping, nothing to flush
+		return region * regionSize;
+	}
+	GLState::bindBuffer(GL_ARRAY_BUFFER, bufferID);
+	glBufferData(GL_ARRAY_BUFFER, regionSize, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &staging[0]);
+	return 0;
+}
+
+void StreamBuffer::fence()
+{
+	if (mapped != NULL)
+	{
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
@@ -0,0 +1,52 @@
+/*
+ * Ring buffer for data the CPU rewrites every frame.
+ *
+ * The buffer is split into FRAMES regions, each guarded by a fence, so the
+ * CPU writes one region while the GPU may still read the previous ones.
+ * With ARB_buffer_storage (GL 4.4) the buffer is mapped once, persistently
+ * and coherently, and begin() hands out a pointer straight into it. Without
+ * it, begin() returns CPU staging memory and commit() orphans the buffer and
+ * copies the bytes in.
+ *
+ * Per frame: p = begin(bytes); write; offset = commit(bytes); draw; fence().
+ */
+
+#pragma once
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <vector>
+#include <glad/glad.h>
+
+class StreamBuffer
+{
+public:
+	static const int FRAMES = 3;
+
+	StreamBuffer();
+	~StreamBuffer();
+
+	// room for `bytes` in the next region, waits if the GPU is still reading it
+	void *begin(size_t bytes);
+	// makes the written bytes visible to later draws, returns their offset in the buffer
+	size_t commit(size_t bytes);
+	// call after the draws that read the region
+	void fence();
+
+	GLuint getBuffer() const { return bufferID; }
+	bool isPersistent() const { return mapped != NULL; }
+	size_t getRegionSize() const { return regionSize; }
+
+private:
+	void allocate(size_t bytes);
+	void release();
+
+	GLuint bufferID;
+	size_t regionSize;
+	int region; // region written this frame
+	char *mapped; // persistent mapping, NULL when orphaning
+	GLsync fences[FRAMES];
+	std::vector<char> staging;
+};
+
+#endif // STREAMBUFFER_H
@@ -5,6 +5,8 @@
 #include <glad/glad.h>
 #include <string>
 
+class Program;
+
 class Texture
 {
 public:
@@ -14,7 +16,9 @@ public:
 	void init();
 	void setUnit(GLint u) { unit = u; }
 	GLint getUnit() const { return unit; }
-	void bind(GLint handle);
+	// binds to the unit and points the sampler (a Program::getUniformID id)
+	// at it, prog has to be bound
+	void bind(Program &prog, int samplerID);
 	void unbind();
 	void setWrapModes(GLint wrapS, GLint wrapT); // Must be called after init()
 	GLint getID() const { return tid;}
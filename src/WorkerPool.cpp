@@ -0,0 +1,128 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+// set while a thread is running chunks, nested parallelFor calls run inline
+static thread_local bool insideJob = false;
+
+// only one parallelFor is in flight at a time
+static std::mutex submitMutex;
+
+WorkerPool::WorkerPool(unsigned numThreads) :
+	quit(false),
+	job(nullptr),
+	jobCount(0),
+	jobGrain(1),
+	generation(0),
+	nextChunk(0),
+	busyWorkers(0)
+{
+	if (numThreads == 0)
+	{
+		unsigned hw = std::thread::hardware_concurrency();
+		numThreads = hw > 1 ? hw - 1 : 0;
+	}
+	for (unsigned i = 0; i < numThreads; i++)
+	{
+		workers.push_back(std::thread(&WorkerPool::workerLoop, this));
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+}
+
+WorkerPool &WorkerPool::shared()
+{
+	static WorkerPool pool;
+	return pool;
+}
+
+void WorkerPool::runChunks()
+{
+	bool wasInside = insideJob;
+	insideJob = true;
+	for (;;)
+	{
+		int chunk = nextChunk++;
+		long long begin = (long long)chunk * jobGrain;
+		if (begin >= jobCount)
+		{
+			break;
+		}
+		int end = (int)(std::min)(begin + jobGrain, (long long)jobCount);
+		(*job)((int)begin, end);
+	}
+	insideJob = wasInside;
+}
+
+void WorkerPool::workerLoop()
+{
+	unsigned seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return quit || generation != seen; });
+			if (quit)
+			{
+				return;
+			}
+			seen = generation;
+		}
+
+		runChunks();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busyWorkers == 0)
+		{
+			done.notify_all();
+		}
+	}
+}
+
+void WorkerPool::parallelFor(int count, int grain, const std::function<void(int begin, int end)> &fn)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+	grain = (std::max)(grain, 1);
+
+	// not worth waking anyone (or already on a worker): run on this thread
+	if (workers.empty() || count <= grain || insideJob)
+	{
+		for (int begin = 0; begin < count; begin += grain)
+		{
+			fn(begin, (std::min)(begin + grain, count));
+		}
+		return;
+	}
+
+	std::lock_guard<std::mutex> submit(submitMutex);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &fn;
+		jobCount = count;
+		jobGrain = grain;
+		nextChunk = 0;
+		busyWorkers = (int)workers.size();
+		generation++;
+	}
+	wake.notify_all();
+
+	runChunks();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [&] { return busyWorkers == 0; });
+	job = nullptr;
+}
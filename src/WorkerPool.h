@@ -0,0 +1,56 @@
+/*
+ * Small fixed-size thread pool for data-parallel loops.
+ *
+ * parallelFor(count, grain, fn) splits [0, count) into chunks of `grain`
+ * items and calls fn(begin, end) for each chunk from the worker threads and
+ * the calling thread. It returns once every chunk is done, so callers can use
+ * it like an ordinary for loop. Chunks cover contiguous, increasing ranges,
+ * which lets callers keep per-chunk output and concatenate it in order.
+ */
+
+#pragma once
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+class WorkerPool
+{
+public:
+	// numThreads = 0 uses one worker per hardware thread, minus the caller
+	WorkerPool(unsigned numThreads = 0);
+	~WorkerPool();
+
+	void parallelFor(int count, int grain, const std::function<void(int begin, int end)> &fn);
+
+	// number of threads that run chunks, including the caller
+	unsigned getNumThreads() const { return (unsigned)workers.size() + 1; }
+
+	// pool shared by the whole application
+	static WorkerPool &shared();
+
+private:
+	void workerLoop();
+	void runChunks();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	bool quit;
+
+	// current job
+	const std::function<void(int, int)> *job;
+	int jobCount;
+	int jobGrain;
+	unsigned generation;
+	std::atomic<int> nextChunk;
+	int busyWorkers;
+};
+
+#endif // WORKERPOOL_H
@@ -43,6 +43,7 @@
 #include <glad/glad.h>
 
 #include "GLSL.h"
+#include "GLState.h"
 #include "Program.h"
 #include "Shape.h"
 #include "MatrixStack.h"
@@ -51,6 +52,18 @@
 #include "physics/PhysicsObject.h"
 #include "physics/ColliderSphere.h"
 #include "physics/ColliderMesh.h"
+#include "physics/PhysicsHistory.h"
+#include "physics/SceneQuery.h"
+#include "physics/PhysicsStats.h"
+#include "Picker.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "CameraBuffer.h"
+#include "RenderQueue.h"
+#include "InstanceBatch.h"
+#include "Impostor.h"
+#include "LightClusters.h"
+#include "MeshCache.h"
 #include "Constants.h"
 #include "Spider.h"
 #include "ShaderManager.h"
@@ -68,6 +81,10 @@ using namespace glm;
 
 TimeData Time;
 
+// ids of the things that can be clicked on
+enum PickID {PICK_HAND, PICK_SPIDER, PICK_EYE, PICK_PUPIL, PICK_PHYSICS, PICK_PROP};
+static const char *pickNames[] = {"hand", "spider", "eye", "pupil", "physics object", "prop"};
+
 class Application : public EventCallbacks
 {
 
@@ -79,25 +96,57 @@ public:
 
 	// Shape to be used (from  file) - modify to support multiple
 	shared_ptr<Shape> sphere;
+	// N scatters bunnies (big meshes, for LOD comparisons), V toggles their LOD
+	vector<shared_ptr<GameObject>> props;
+	shared_ptr<Shape> bunny;
+	// G scatters 50k more, H draws the ones past impostorDistance as billboards
+	Impostor bunnyImpostor;
+	bool useImpostors = false;
+	float impostorDistance = 20.0f;
 	shared_ptr<Shape> cube;
 
 	vector<shared_ptr<PhysicsObject>> physicsObjects;
 
+	// physics timeline, snapshotted so it can be scrubbed backwards
+	PhysicsHistory physicsHistory;
+	int physicsStep = 0;
+
+	// overlap/sweep/closest point queries against physicsObjects, rebuilt
+	// before the first batch after the bodies moved. Q benchmarks it.
+	SceneQuery sceneQuery;
+	bool sceneQueryDirty = true;
+
+	// simulation LOD is picked from the distance to the camera
+	vec3 cameraPos = vec3(0);
+	float physicsStepTime = 0; // running average, milliseconds
+	FrustumCuller frustumCuller; // C toggles GameObject culling
+	OcclusionCuller occlusionCuller; // O toggles, on top of frustum culling
+	bool occlusionCulling = false;
+	std::string resourceDir;
+	bool usePrimitives = false; // generate the spheres instead of loading their OBJ files
+
 	//hand
 	vector<shared_ptr<Shape>> hand;
 
 	//spider
 	vector<shared_ptr<Shape>> spider;
+	vector<shared_ptr<Shape>> spiderBatched; // every part merged into one buffer, one draw
+	bool batchSpider = true; // M toggles, to compare against drawing the parts
 
 	// 8 Eyes
-	vector<shared_ptr<Shape>> eye1;
-	vector<shared_ptr<Shape>> eye2;
-	vector<shared_ptr<Shape>> eye3;
-	vector<shared_ptr<Shape>> eye4;
-	vector<shared_ptr<Shape>> eye5;
-	vector<shared_ptr<Shape>> eye6;
-	vector<shared_ptr<Shape>> eye7;
-	vector<shared_ptr<Shape>> eye8;
+	// one mesh, drawn instanced for every eye and pupil
+	vector<shared_ptr<Shape>> eye;
+	InstanceBatch eyeInstances;
+	InstanceBatch pupilInstances;
+	// X draws eyes, pupils and sphere colliders as ray-cast quads instead
+	bool sphereImpostors = false;
+	InstanceBatch sphereInstances; // sphere colliders, refilled every frame
+
+	// 10k eyes for profiling instancing (I key)
+	InstanceBatch stressInstances;
+	bool eyeStress = false;
+	float renderTime = 0; // CPU time of render(), running average in milliseconds
+	float frameTime = 0; // time between frames, running average in milliseconds
 
 	// spline vectors for "animation"
 	vector<Spline> spiderPaths;
@@ -126,6 +175,26 @@ public:
 	float yhandRot = 0;		//y-axis
 	float zhandRot = 0;		//z-axis
 
+	// everything drawn last frame, for click-to-select
+	Picker picker;
+	mat4 lastProjection = mat4(1);
+	mat4 lastView = mat4(1);
+
+	// P, V, viewport and time for every shader, filled once per frame
+	CameraBuffer cameraBuffer;
+
+	// F scatters practical lights, binned into view clusters every frame
+	LightClusters lightClusters;
+
+	// every draw of the frame, sorted by program and mesh before it runs
+	RenderQueue renderQueue;
+
+	// uniform uploads issued and skipped as unchanged during the last frame
+	int lastUniformUploads = 0;
+	int lastUniformsElided = 0;
+	int lastStateCalls = 0;
+	int lastStateCallsElided = 0;
+
 	// Contains vertex information for OpenGL
 	GLuint VertexArrayID;
 
@@ -147,6 +216,124 @@ public:
 		if (key == GLFW_KEY_Z && action == GLFW_RELEASE) {
 			glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
 		}
+		// scrub the physics timeline by one second
+		if (key == GLFW_KEY_LEFT && action == GLFW_PRESS) {
+			seekPhysics(physicsStep - (int)(1.0f / Time.physicsDeltaTime));
+		}
+		if (key == GLFW_KEY_RIGHT && action == GLFW_PRESS) {
+			seekPhysics(physicsStep + (int)(1.0f / Time.physicsDeltaTime));
+		}
+		// toggle physics LOD and report the average step time before the switch
+		if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+			cout << "Physics LOD " << (PhysicsObject::simLODEnabled ? "on" : "off") << ": "
+				<< physicsStepTime << " ms/step, " << physicsObjects.size() << " bodies" << endl;
+			PhysicsObject::setSimLOD(!PhysicsObject::simLODEnabled);
+			physicsStepTime = 0;
+		}
+		if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+			scatterPhysicsObjects(1000, 100.0f);
+		}
+		if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+			GameObject::setCulling(!GameObject::cull);
+			cout << "Frustum culling " << (GameObject::cull ? "on" : "off") << endl;
+		}
+		if (key == GLFW_KEY_O && action == GLFW_PRESS) {
+			occlusionCulling = !occlusionCulling;
+			cout << "Occlusion culling " << (occlusionCulling ? "on" : "off")
+				<< (GameObject::cull ? "" : " (needs frustum culling, C)") << endl;
+		}
+		if (key == GLFW_KEY_U && action == GLFW_PRESS) {
+			Shape::meshletCulling = !Shape::meshletCulling;
+			cout << "Meshlet culling " << (Shape::meshletCulling ? "on" : "off") << endl;
+		}
+		if (key == GLFW_KEY_N && action == GLFW_PRESS) {
+			scatterBunnies(300, 60.0f);
+		}
+		if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+			cout << "LOD " << (GameObject::useLOD ? "on" : "off") << ": " << renderTime << " ms CPU, "
+				<< renderQueue.getTriangles() << " triangles" << endl;
+			GameObject::setLOD(!GameObject::useLOD);
+		}
+		if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+			scatterBunnies(50000, 400.0f);
+		}
+		if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+			if (!bunnyImpostor.isBaked()) {
+				cout << "No bunny impostor to draw" << endl;
+			}
+			else {
+				cout << "Impostors " << (useImpostors ? "on" : "off") << ": " << frameTime << " ms/frame, "
+					<< renderTime << " ms CPU, " << renderQueue.getTriangles() << " triangles, "
+					<< bunnyImpostor.size() << " impostors" << endl;
+				useImpostors = !useImpostors;
+			}
+		}
+		if (key == GLFW_KEY_J && action == GLFW_PRESS) {
+			benchmarkMeshlets(72);
+		}
+		if (key == GLFW_KEY_Q && action == GLFW_PRESS) {
+			benchmarkSceneQueries(10000);
+		}
+		if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+			batchSpider = !batchSpider;
+			cout << "Spider " << (batchSpider ? "batched" : "unbatched") << ": "
+				<< (batchSpider ? spiderBatched.size() : spider.size()) << " draws" << endl;
+		}
+		if (key == GLFW_KEY_X && action == GLFW_PRESS) {
+			cout << "Sphere impostors " << (sphereImpostors ? "on" : "off") << ": " << frameTime << " ms/frame, "
+				<< renderQueue.getTriangles() << " triangles" << endl;
+			sphereImpostors = !sphereImpostors;
+		}
+		if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+			toggleEyeStress();
+		}
+		if (key == GLFW_KEY_F && action == GLFW_PRESS) {
+			scatterLights(64, 40.0f);
+		}
+		if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+			cout << "Last frame: " << renderTime << " ms CPU, " << renderQueue.getDraws() << " draws ("
+				<< renderQueue.getInstances() << " instances), "
+				<< renderQueue.getProgramBinds() << " program binds, "
+				<< renderQueue.getVAOBinds() << " VAO binds, "
+				<< lastUniformUploads << " uniform uploads, "
+				<< lastUniformsElided << " elided, "
+				<< lastStateCalls << " state calls, " << lastStateCallsElided << " elided, "
+				<< renderQueue.getTriangles() << " triangles" << endl;
+			if (Shape::meshletCulling) {
+				cout << "Meshlet culling: " << renderQueue.getMeshletTriangles() << " of "
+					<< renderQueue.getMeshletTrianglesTotal() << " triangles drawn" << endl;
+			}
+			if (GameObject::cull) {
+				cout << "Frustum culling: " << frustumCuller.getCulled() << " of " << frustumCuller.getNumObjects()
+					<< " objects culled, " << frustumCuller.getNodesVisited() << " nodes visited, "
+					<< frustumCuller.getCullTime() << " ms" << endl;
+			}
+			if (GameObject::cull && occlusionCulling) {
+				cout << "Occlusion culling: " << occlusionCuller.getOccluded() << " of " << occlusionCuller.getTested()
+					<< " objects occluded by " << occlusionCuller.getOccluderTriangles() << " tris, "
+					<< occlusionCuller.getRasterTime() << " ms raster, " << occlusionCuller.getTestTime() << " ms test" << endl;
+			}
+			if (lightClusters.size() > 0) {
+				cout << "Lights: " << lightClusters.getVisibleLights() << " of " << lightClusters.size()
+					<< " in view, " << lightClusters.getAveragePerCluster() << " per lit cluster (max "
+					<< lightClusters.getMaxPerCluster() << "), " << lightClusters.getIndexCount() << " indices, "
+					<< lightClusters.getBinTime() << " ms binning" << endl;
+			}
+			benchmarkDraws(10000);
+		}
+		// dump the recent physics step counters and timings
+		if (key == GLFW_KEY_K && action == GLFW_PRESS) {
+			const PhysicsStepStats &s = PhysicsStats::get().last();
+			cout << "Physics step " << s.step << ": " << s.pairsConsidered << " pairs ("
+				<< s.pairsCulled << " culled), " << s.trianglesTested << " tris, "
+				<< s.contactsGenerated << " contacts (" << s.contactsRemoved << " filtered)";
+			for (int p = 0; p < NUM_PHYSICS_PHASES; p++) {
+				cout << ", " << PhysicsStats::phaseName(p) << " " << s.phaseTime[p] << " ms";
+			}
+			cout << endl;
+			PhysicsStats::get().writeCSV("physics_stats.csv");
+			PhysicsStats::get().writeJSON("physics_stats.json");
+		}
 	}
 
 	void mouseCallback(GLFWwindow *window, int button, int action, int mods)
@@ -157,6 +344,35 @@ public:
 		{
 			 glfwGetCursorPos(window, &posX, &posY);
 			 cout << "Pos X " << posX <<  " Pos Y " << posY << endl;
+
+			 // cursor is in window coordinates, the matrices expect framebuffer pixels
+			 int winWidth, winHeight, width, height;
+			 glfwGetWindowSize(window, &winWidth, &winHeight);
+			 glfwGetFramebufferSize(window, &width, &height);
+			 posX *= width / (double)winWidth;
+			 posY *= height / (double)winHeight;
+
+			 auto start = chrono::high_resolution_clock::now();
+			 vec3 origin, dir;
+			 PickResult pick;
+			 Picker::unproject(posX, posY, width, height, lastProjection, lastView, origin, dir);
+			 bool hit = picker.pick(origin, dir, pick);
+			 float ms = chrono::duration_cast<std::chrono::microseconds>(
+				 chrono::high_resolution_clock::now() - start).count() * 0.001f;
+
+			 if (hit && pick.object != nullptr) {
+				 vec3 p = pick.object->position;
+				 cout << "Picked " << pickNames[pick.id] << " at (" << p.x << ", " << p.y << ", " << p.z << ")"
+					 << " triangle " << pick.triangle << " at distance " << pick.distance << " (" << ms << " ms)" << endl;
+			 }
+			 else if (hit) {
+				 cout << "Picked " << pickNames[pick.id] << " triangle " << pick.triangle
+					 << " bary (" << pick.bary.x << ", " << pick.bary.y << ")"
+					 << " at distance " << pick.distance << " (" << ms << " ms)" << endl;
+			 }
+			 else {
+				 cout << "Picked nothing (" << ms << " ms)" << endl;
+			 }
 		}
 	}
 
@@ -172,42 +388,281 @@ public:
 		// Set background color.
 		glClearColor(0.5,0.2,0.2, 1.0f);
 		// Enable z-buffer test.
-		glEnable(GL_DEPTH_TEST);
+		GLState::enable(GL_DEPTH_TEST);
+
+		this->resourceDir = resourceDirectory;
 
         // create the Instance of ShaderManager which will initialize all shaders in its constructor
 		shaderManager = new ShaderManager(resourceDirectory);
+
+		cameraBuffer.init();
+		lightClusters.init();
 	}
 
 	void loadMultiPartObject(const std::string& resource, vector<shared_ptr<Shape>>* object)
 	{
-		// Initialize mesh
-		// Load geometry
-		// Some obj files contain material information.We'll ignore them for this assignment.
-		vector<tinyobj::shape_t> TOshapes;
-		vector<tinyobj::material_t> objMaterials;
-		string errStr;
-		shared_ptr<Shape> s;
-		//load in the mesh and make the shape(s)
-		bool rc = tinyobj::LoadObj(TOshapes, objMaterials, errStr, (resource).c_str());
-		if (!rc) {
-			cerr << errStr << endl;
+		// parsed and uploaded once per distinct file, the parts share the cached asset
+		MeshCache::shared().loadParts(resource, *object);
+	}
+
+	void drawMultiPartObject(vector<shared_ptr<Shape>>* object, shared_ptr<Program>* program, const mat4 &M, int pickId)
+	{
+		for (int i = 0; i < object->size(); i++)
+			renderQueue.submit(program->get(), (*object)[i].get(), M);
+		picker.add(*object, M, pickId);
+	}
+
+	// Every part of the object is drawn once for all instances in the batch
+	void drawInstancedObject(vector<shared_ptr<Shape>>* object, int program, InstanceBatch &batch, int pickId)
+	{
+		Program *prog = shaderManager->shaderMap[program].get();
+		for (int i = 0; i < object->size(); i++)
+			renderQueue.submitInstanced(prog, (*object)[i].get(), &batch);
+		if (pickId >= 0) {
+			for (const InstanceBatch::Instance &instance : batch.getInstances())
+				picker.add(*object, instance.M, pickId);
+		}
+	}
+
+	// Eyes and pupils are unit spheres scaled by their instance matrix, so
+	// with sphere impostors on every instance becomes one ray-cast quad
+	void drawEyeInstances(int program, InstanceBatch &batch, int pickId)
+	{
+		if (!sphereImpostors) {
+			drawInstancedObject(&eye, program, batch, pickId);
+			return;
+		}
+		renderQueue.submitInstanced(shaderManager->shaderMap[SPHEREPROG].get(), Shape::unitQuad().get(), &batch);
+		if (pickId >= 0) {
+			for (const InstanceBatch::Instance &instance : batch.getInstances())
+				picker.add(eye, instance.M, pickId);
+		}
+	}
+
+	// 100 x 100 eyes filling the view, for comparing instanced and plain draws
+	void toggleEyeStress()
+	{
+		eyeStress = !eyeStress;
+		if (eyeStress && stressInstances.size() == 0) {
+			for (int y = 0; y < 100; y++) {
+				for (int x = 0; x < 100; x++) {
+					vec3 pos = vec3((x - 49.5f) * 0.05f, (y - 49.5f) * 0.05f, -4.0f);
+					stressInstances.add(translate(mat4(1), pos) * scale(mat4(1), vec3(0.02f)), vec4(0.8f, 0.8f, 0.8f, 1));
+				}
+			}
+		}
+		cout << "Eye stress test " << (eyeStress ? "on" : "off") << endl;
+	}
+
+	// Report the bunny loaded by initGeom and bake its impostor, once
+	void prepareBunny()
+	{
+		if (bunny == nullptr) {
+			return;
+		}
+		cout << "Bunny LODs:";
+		for (int i = 0; i < bunny->getNumLODs(); i++) {
+			cout << " " << bunny->getLODTriangles(i);
+		}
+		cout << " triangles" << endl;
+		if (bunny->getAOBakeTime() > 0) {
+			cout << "Bunny AO: " << bunny->getNumVertices() << " vertices baked in " << bunny->getAOBakeTime()
+				<< " ms on " << WorkerPool::shared().getNumThreads() << " threads" << endl;
 		}
 		else {
-			for (int i = 0; i < TOshapes.size(); i++)
-			{
-				s = make_shared<Shape>();
-				s->createShape(TOshapes[i]);
-				s->measure();
-				s->init();
-				object->push_back(s);
+			cout << "Bunny AO: " << (bunny->hasAO() ? "read from cache" : "none") << endl;
+		}
+		if (!bunnyImpostor.bake(*bunny, *shaderManager->shaderMap[IMPOSTORBAKEPROG], vec3(0.5, 0.4, 0.3))) {
+			cout << "Bunny impostor not baked, bunnies are always drawn as meshes" << endl;
+		}
+	}
+
+	// Scatter bunnies (dense static props) over the ground in front of the camera
+	void scatterBunnies(int count, float extent)
+	{
+		if (bunny == nullptr) {
+			return;
+		}
+		float unit = 1.0f / (std::max)((std::max)(bunny->size.x, bunny->size.y), (std::max)(bunny->size.z, 1e-6f));
+		for (int i = 0; i < count; i++) {
+			vec3 pos = vec3(extent * (rand() / (float)RAND_MAX - 0.5f), -1.0f,
+				-2.0f - extent * (rand() / (float)RAND_MAX));
+			props.push_back(make_shared<GameObject>(pos, quat(1, 0, 0, 0), vec3(unit), bunny));
+		}
+		cout << props.size() << " bunnies" << endl;
+	}
+
+	// Small colored point lights over the area the bunnies are scattered in
+	void scatterLights(int count, float extent)
+	{
+		for (int i = 0; i < count; i++) {
+			vec3 pos = vec3(extent * (rand() / (float)RAND_MAX - 0.5f), -1.0f + 2.0f * (rand() / (float)RAND_MAX),
+				-2.0f - extent * (rand() / (float)RAND_MAX));
+			vec3 color = vec3(rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX);
+			lightClusters.add(pos, 2.0f + 3.0f * (rand() / (float)RAND_MAX), color * 2.0f);
+		}
+		cout << lightClusters.size() << " lights: " << frameTime << " ms/frame, "
+			<< lightClusters.getBinTime() << " ms binning" << endl;
+	}
+
+	// Scatter spheres over a wide area, used to profile physics LOD. There is
+	// no ground, so they fall freely and the step time covers integration and
+	// the broad phase rather than resting contacts.
+	void scatterPhysicsObjects(int count, float extent)
+	{
+		if (sphere == nullptr && usePrimitives) {
+			sphere = MeshCache::shared().loadPrimitive(Primitives::ICOSPHERE);
+		}
+		if (sphere == nullptr) {
+			vector<shared_ptr<Shape>> parts;
+			loadMultiPartObject(resourceDir + "/models/sphere.obj", &parts);
+			if (parts.empty()) {
+				return;
 			}
+			sphere = parts[0];
+		}
+		for (int i = 0; i < count; i++) {
+			vec3 pos = vec3(extent * (rand() / (float)RAND_MAX - 0.5f), 0,
+				-extent * (rand() / (float)RAND_MAX));
+			auto obj = make_shared<PhysicsObject>(pos, sphere, make_shared<ColliderSphere>(sphere->size.x / 2));
+			obj->setMass(1);
+			physicsObjects.push_back(obj);
 		}
+		// the snapshots no longer match the set of bodies
+		physicsHistory.clear();
+		physicsStep = 0;
+		sceneQueryDirty = true;
 	}
 
-	void drawMultiPartObject(vector<shared_ptr<Shape>>* object, shared_ptr<Program>* program)
+	// Time the CPU side of submitting `count` draws of the eye mesh through
+	// the render queue, including streaming their per-object data
+	void benchmarkDraws(int count)
 	{
-		for (int i = 0; i < object->size(); i++)
-			(*object)[i]->draw(*program);
+		if (eye.empty()) {
+			return;
+		}
+		Program *prog = shaderManager->shaderMap[EYEPROG].get();
+		glFinish();
+
+		auto start = chrono::high_resolution_clock::now();
+		renderQueue.begin(lastView, 100);
+		int side = (int)ceil(sqrt((float)count));
+		for (int i = 0; i < count; i++) {
+			mat4 M = translate(mat4(1), vec3(i % side - side / 2, 0, i / side - side / 2));
+			renderQueue.submit(prog, eye[i % eye.size()].get(), M);
+		}
+		renderQueue.execute();
+		double submit = chrono::duration<double, micro>(chrono::high_resolution_clock::now() - start).count();
+		glFinish();
+		double total = chrono::duration<double, micro>(chrono::high_resolution_clock::now() - start).count();
+
+		cout << count << (eye[0]->isCompact() ? " compact" : " float") << " draws: " << submit / count << " us/draw submitted, "
+			<< total / 1000.0 << " ms until finished, " << renderQueue.getStreamTime() << " ms writing object data ("
+			<< (renderQueue.isStreamPersistent() ? "persistent" : "orphaned") << " stream)" << endl;
+	}
+
+	// Orbit the camera around the big models and report how many triangles
+	// survive meshlet frustum and backface culling
+	void benchmarkMeshlets(int steps)
+	{
+		const char *models[] = {"bunny.obj", "dummy.obj"};
+		for (const char *model : models) {
+			vector<shared_ptr<Shape>> parts;
+			loadMultiPartObject(resourceDir + "/models/" + model, &parts);
+			if (parts.empty()) {
+				continue;
+			}
+			vec3 lo = parts[0]->min, hi = parts[0]->max;
+			size_t meshlets = 0;
+			for (auto part : parts) {
+				lo = glm::min(lo, part->min);
+				hi = glm::max(hi, part->max);
+				meshlets += part->getMeshlets().size();
+			}
+			vec3 center = (lo + hi) * 0.5f;
+			float radius = length(hi - lo) * 0.5f;
+
+			long long kept = 0, total = 0;
+			vector<Shape::SubRange> visible;
+			auto start = chrono::high_resolution_clock::now();
+			for (int s = 0; s < steps; s++) {
+				float angle = 2.0f * (float)M_PI * s / steps;
+				vec3 eyePos = center + vec3(sin(angle), 0.3f, cos(angle)) * radius * 2.0f;
+				mat4 PV = lastProjection * lookAt(eyePos, center, vec3(0, 1, 0));
+				for (auto part : parts) {
+					total += part->getIndices().size() / 3;
+					kept += part->hasMeshlets() ? part->cullMeshlets(mat4(1), PV, eyePos, visible)
+						: part->getIndices().size() / 3;
+				}
+			}
+			double us = chrono::duration<double, micro>(chrono::high_resolution_clock::now() - start).count();
+
+			cout << model << ": " << meshlets << " meshlets, " << 100.0 * kept / (std::max)(total, 1LL)
+				<< "% of " << total / steps << " triangles kept per frame, " << us / steps << " us/frame culling" << endl;
+		}
+	}
+
+	// count queries, a quarter of each kind, spread over the physics objects
+	void benchmarkSceneQueries(int count)
+	{
+		if (physicsObjects.empty()) {
+			cout << "No physics objects to query, P scatters some" << endl;
+			return;
+		}
+		float buildMs = 0;
+		if (sceneQueryDirty) {
+			auto start = chrono::high_resolution_clock::now();
+			sceneQuery.build(physicsObjects);
+			sceneQueryDirty = false;
+			buildMs = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - start).count();
+		}
+
+		vec3 lo = physicsObjects[0]->getCenterPos(), hi = lo;
+		for (auto obj : physicsObjects) {
+			lo = glm::min(lo, obj->getCenterPos());
+			hi = glm::max(hi, obj->getCenterPos());
+		}
+		lo -= vec3(1);
+		hi += vec3(1);
+		auto randomPoint = [&]() {
+			return lo + (hi - lo) * vec3(rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX);
+		};
+
+		int each = count / 4;
+		vector<SphereOverlapQuery> spheres(each);
+		vector<BoxOverlapQuery> boxes(each);
+		vector<SphereSweepQuery> sweeps(each);
+		vector<ClosestPointQuery> points(each);
+		for (int i = 0; i < each; i++) {
+			spheres[i].center = randomPoint();
+			spheres[i].radius = 1.0f;
+			boxes[i].min = randomPoint();
+			boxes[i].max = boxes[i].min + vec3(2.0f);
+			sweeps[i].origin = randomPoint();
+			sweeps[i].direction = normalize(randomPoint() - sweeps[i].origin + vec3(1e-3f));
+			sweeps[i].radius = 0.25f;
+			sweeps[i].maxDistance = 10.0f;
+			points[i].point = randomPoint();
+			points[i].maxDistance = 5.0f;
+		}
+
+		OverlapResults overlaps;
+		SweepResults hits;
+		ClosestPointResults closest;
+		float us[4];
+		sceneQuery.overlapSpheres(spheres, overlaps);
+		us[0] = sceneQuery.getLastBatchTime() * 1000.0f / each;
+		sceneQuery.overlapBoxes(boxes, overlaps);
+		us[1] = sceneQuery.getLastBatchTime() * 1000.0f / each;
+		sceneQuery.sweepSpheres(sweeps, hits);
+		us[2] = sceneQuery.getLastBatchTime() * 1000.0f / each;
+		sceneQuery.closestPoints(points, closest);
+		us[3] = sceneQuery.getLastBatchTime() * 1000.0f / each;
+
+		cout << 4 * each << " scene queries over " << physicsObjects.size() << " objects ("
+			<< (buildMs > 0 ? to_string(buildMs) + " ms rebuild" : string("no rebuild")) << "): "
+			<< us[0] << " us/sphere overlap, " << us[1] << " us/box overlap, "
+			<< us[2] << " us/sweep, " << us[3] << " us/closest point" << endl;
 	}
 
 	void initTextures(const std::string& resourceDirectory)
@@ -217,17 +672,29 @@ public:
 
 	void initGeom(const std::string& resourceDirectory)
 	{
-		//loadMultiPartObject(resourceDirectory + "/models/hand_low_quality.obj", &hand);
-		loadMultiPartObject(resourceDirectory + "/models/spider_low_quality.obj", &spider);
-		loadMultiPartObject(resourceDirectory + "/models/hand_low_quality.obj", &hand);
-		loadMultiPartObject(resourceDirectory + "/models/ico_sphere.obj", &eye1);
-		loadMultiPartObject(resourceDirectory + "/models/ico_sphere.obj", &eye2);
-		loadMultiPartObject(resourceDirectory + "/models/ico_sphere.obj", &eye3);
-		loadMultiPartObject(resourceDirectory + "/models/ico_sphere.obj", &eye4);
-		loadMultiPartObject(resourceDirectory + "/models/ico_sphere.obj", &eye5);
-		loadMultiPartObject(resourceDirectory + "/models/ico_sphere.obj", &eye6);
-		loadMultiPartObject(resourceDirectory + "/models/ico_sphere.obj", &eye7);
-		loadMultiPartObject(resourceDirectory + "/models/ico_sphere.obj", &eye8);
+		// one batch, so the LOD chains of every part (the single part bunny's
+		// too) build in parallel, and N doesn't load anything mid-session
+		vector<string> paths = {resourceDirectory + "/models/spider_low_quality.obj",
+			resourceDirectory + "/models/hand_low_quality.obj", resourceDirectory + "/models/bunny.obj"};
+		if (!usePrimitives) {
+			paths.push_back(resourceDirectory + "/models/ico_sphere.obj");
+		}
+		vector<shared_ptr<MeshAsset>> assets = MeshCache::shared().load(paths);
+		MeshCache::appendParts(assets[0], spider);
+		if (!spider.empty()) {
+			spiderBatched.push_back(Shape::merge(spider));
+		}
+		MeshCache::appendParts(assets[1], hand);
+		if (assets[2] != nullptr && !assets[2]->parts.empty()) {
+			bunny = MeshAsset::part(assets[2], 0);
+			prepareBunny();
+		}
+		if (usePrimitives) {
+			eye.push_back(MeshCache::shared().loadPrimitive(Primitives::ICOSPHERE));
+		}
+		else {
+			MeshCache::appendParts(assets[3], eye);
+		}
 
 		//read out information stored in the shape about its size - something like this...
 		//then do something with that information.....
@@ -267,31 +734,38 @@ public:
 		eyePaths.push_back(Spline(eye8Pos, eye3Pos, eye3Pos, 3));
 	}
     
-    mat4 SetProjectionMatrix(shared_ptr<Program> curShader) {
-        int width, height;
-        glfwGetFramebufferSize(windowManager->getHandle(), &width, &height);
-        float aspect = width/(float)height;
-        mat4 Projection = perspective(radians(50.0f), aspect, 0.1f, 100.0f);
-        glUniformMatrix4fv(curShader->getUniform("P"), 1, GL_FALSE, value_ptr(Projection));
-        return Projection;
-    }
-    
-    void SetViewMatrix(shared_ptr<Program> curShader) {
-        auto View = make_shared<MatrixStack>();
-        View->pushMatrix();
-        glUniformMatrix4fv(curShader->getUniform("V"), 1, GL_FALSE, value_ptr(View->topMatrix()));
-        View->popMatrix();
-    }
-
 	void render(float frametime) {
+		auto start = chrono::high_resolution_clock::now();
 		// Get current frame buffer size.
 		int width, height;
 		glfwGetFramebufferSize(windowManager->getHandle(), &width, &height);
 		glViewport(0, 0, width, height);
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		lastProjection = perspective(radians(50.0f), width/(float)height, 0.1f, 100.0f);
+		lastView = mat4(1);
+		cameraBuffer.update(lastProjection, lastView, vec4(0, 0, width, height), (float)glfwGetTime(), frametime);
+		lightClusters.update(lastProjection, lastView, 0.1f, 100.0f);
+		picker.clear();
+		lastUniformUploads = Program::getUploadCount();
+		lastUniformsElided = Program::getElidedCount();
+		Program::resetUploadStats();
+		lastStateCalls = GLState::getIssued();
+		lastStateCallsElided = GLState::getElided();
+		GLState::resetStats();
+		renderQueue.begin(lastView, 100.0f);
+		renderQueue.setProjection(lastProjection);
         shaderManager->setCurrentShader(SIMPLEPROG);
         renderSimpleProg(frametime);
+		renderQueue.execute();
+		bunnyImpostor.draw(*shaderManager->shaderMap[IMPOSTORPROG]);
+		lightClusters.fence();
+
+		float ms = chrono::duration_cast<std::chrono::microseconds>(
+			chrono::high_resolution_clock::now() - start).count() * 0.001f;
+		renderTime = renderTime == 0 ? ms : renderTime * 0.95f + ms * 0.05f;
+		frameTime = frameTime == 0 ? frametime * 1000.0f : frameTime * 0.95f + frametime * 1000.0f * 0.05f;
 	}
     
     void renderSimpleProg(float frametime) {
@@ -353,12 +827,7 @@ public:
 				Model->scale(vec3(0.5, 0.5, 0.5));
 				shaderManager->setCurrentShader(HANDPROG);
 				simple = shaderManager->getCurrentShader();
-				simple->bind();
-	            SetProjectionMatrix(simple);
-         		SetViewMatrix(simple);
-				glUniformMatrix4fv(simple->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix()));
-				drawMultiPartObject(&hand, &simple);
-				simple->unbind();
+				drawMultiPartObject(&hand, &simple, Model->topMatrix(), PICK_HAND);
 				Model->popMatrix();
 			}
 			
@@ -374,136 +843,41 @@ public:
 				eye7Pos = eyePaths.at(4).getPosition();
 				eye8Pos = eyePaths.at(5).getPosition();					
 				
-				// 8 eyes
-				shaderManager->setCurrentShader(PUPILPROG);
-				simple = shaderManager->getCurrentShader();
-				simple->bind();
-	            SetProjectionMatrix(simple);
-         		SetViewMatrix(simple);
-				Model->pushMatrix();
-					Model->loadIdentity();
-					Model->translate(eye1Pos);
-					Model->scale(0.0035);
-					glUniformMatrix4fv(simple->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix()));
-					drawMultiPartObject(&eye1, &simple);
-				Model->popMatrix();
-				
-				Model->pushMatrix();
-					Model->loadIdentity();
-					Model->translate(eye2Pos);
-					Model->scale(0.005);
-					glUniformMatrix4fv(simple->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix()));
-					drawMultiPartObject(&eye2, &simple);
-				Model->popMatrix();
-				
-				Model->pushMatrix();
-					Model->loadIdentity();
-					Model->translate(eye3Pos);
-					Model->scale(0.005);
-					glUniformMatrix4fv(simple->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix()));
-					drawMultiPartObject(&eye3, &simple);
-				Model->popMatrix();
-				
-				Model->pushMatrix();
-					Model->loadIdentity();
-					Model->translate(eye4Pos);
-					Model->scale(0.0035);
-					glUniformMatrix4fv(simple->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix()));
-					drawMultiPartObject(&eye4, &simple);
-				Model->popMatrix();
-				
-				Model->pushMatrix();
-					Model->loadIdentity();
-					Model->translate(eye5Pos);
-					Model->scale(0.0035);
-					glUniformMatrix4fv(simple->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix()));
-					drawMultiPartObject(&eye5, &simple);
-				Model->popMatrix();
-				
-				Model->pushMatrix();
-					Model->loadIdentity();
-					Model->translate(eye6Pos);
-					Model->scale(0.0035);
-					glUniformMatrix4fv(simple->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix()));
-					drawMultiPartObject(&eye6, &simple);
-				Model->popMatrix();
-
-				Model->pushMatrix();
-					Model->loadIdentity();
-					Model->translate(eye7Pos);
-					Model->scale(0.0035);
-					glUniformMatrix4fv(simple->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix()));
-					drawMultiPartObject(&eye7, &simple);
-				Model->popMatrix();
-
-				Model->pushMatrix();
-					Model->loadIdentity();
-					Model->translate(eye8Pos);
-					Model->scale(0.0035);
-					glUniformMatrix4fv(simple->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix()));
-					drawMultiPartObject(&eye8, &simple);
-				Model->popMatrix();
-				simple->unbind();
+				// 8 eyes, one instanced draw
+				vec3 eyePos[8] = {eye1Pos, eye2Pos, eye3Pos, eye4Pos, eye5Pos, eye6Pos, eye7Pos, eye8Pos};
+				eyeInstances.clear();
+				for (int i = 0; i < 8; i++) {
+					// eyes 2 and 3 are the ones the others merge into
+					float size = (i == 1 || i == 2) ? 0.005f : 0.0035f;
+					eyeInstances.add(translate(mat4(1), eyePos[i]) * scale(mat4(1), vec3(size)), vec4(0, 0, 0, 1));
+				}
+				drawEyeInstances(PUPILINSTPROG, eyeInstances, PICK_EYE);
 			}
 
 			// After the eyes merged together, we have 2 big eyes (eye2 + eye 3)
 			else if (eyePaths.at(5).isDone()){
 				glm::vec3 eye3Pos = vec3(0.008, 0.01, -0.2);
 				glm::vec3 eye2Pos = vec3(-0.008, 0.01, -0.2);
-				
-				shaderManager->setCurrentShader(EYEPROG);
-				simple = shaderManager->getCurrentShader();
-				simple->bind();
-	            SetProjectionMatrix(simple);
-         		SetViewMatrix(simple);
-				Model->pushMatrix();
-					Model->loadIdentity();
-					Model->translate(eye2Pos);
-					Model->scale(0.01);
-					glUniformMatrix4fv(simple->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix()));
-					drawMultiPartObject(&eye3, &simple);
-				Model->popMatrix();
 
-				Model->pushMatrix();
-					Model->loadIdentity();
-					Model->translate(eye3Pos);
-					Model->scale(0.01);
-					glUniformMatrix4fv(simple->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix()));
-					drawMultiPartObject(&eye3, &simple);
-				Model->popMatrix();
-				simple->unbind();
+				eyeInstances.clear();
+				eyeInstances.add(translate(mat4(1), eye2Pos) * scale(mat4(1), vec3(0.01)), vec4(0.8, 0.8, 0.8, 1));
+				eyeInstances.add(translate(mat4(1), eye3Pos) * scale(mat4(1), vec3(0.01)), vec4(0.8, 0.8, 0.8, 1));
+				drawEyeInstances(EYEINSTPROG, eyeInstances, PICK_EYE);
 
 				// draw pupils
-				shaderManager->setCurrentShader(PUPILPROG);
-				simple = shaderManager->getCurrentShader();
-				simple->bind();
-	            SetProjectionMatrix(simple);
-         		SetViewMatrix(simple);
-
-				Model->pushMatrix();
-					Model->loadIdentity();
-					Model->translate(vec3(0.008, 0.01, -0.15));
-					Model->scale(0.002);
-					glUniformMatrix4fv(simple->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix()));
-					drawMultiPartObject(&eye3, &simple);
-				Model->popMatrix();
-				Model->pushMatrix();
-					Model->loadIdentity();
-					Model->translate(vec3(-0.008, 0.01, -0.15));
-					Model->scale(0.002);
-					glUniformMatrix4fv(simple->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix()));
-					drawMultiPartObject(&eye3, &simple);
-				Model->popMatrix();
-				simple->unbind();
+				pupilInstances.clear();
+				pupilInstances.add(translate(mat4(1), vec3(0.008, 0.01, -0.15)) * scale(mat4(1), vec3(0.002)), vec4(0, 0, 0, 1));
+				pupilInstances.add(translate(mat4(1), vec3(-0.008, 0.01, -0.15)) * scale(mat4(1), vec3(0.002)), vec4(0, 0, 0, 1));
+				drawEyeInstances(PUPILINSTPROG, pupilInstances, PICK_PUPIL);
+			}
 
+			if (eyeStress) {
+				drawEyeInstances(EYEINSTPROG, stressInstances, -1);
 			}
 
 			// The spider should be shown in all frames
 			shaderManager->setCurrentShader(SPIDERPROG);
 			simple = shaderManager->getCurrentShader();
-			simple->bind();
-	        SetProjectionMatrix(simple);
-         	SetViewMatrix(simple);
 			Model->pushMatrix();
 				Model->loadIdentity();
 				//Model->translate(vec3(0, 0, -1));
@@ -513,24 +887,130 @@ public:
 				Model->rotate(yspidRot, YAXIS);		//rotate along Y
 				Model->rotate(zspidRot, ZAXIS);		//rotate along Z
 				//spider.draw(simple, Model);
-				glUniformMatrix4fv(simple->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix()));
-				drawMultiPartObject(&spider, &simple);
+				drawMultiPartObject(batchSpider && !spiderBatched.empty() ? &spiderBatched : &spider,
+					&simple, Model->topMatrix(), PICK_SPIDER);
+				mat4 spiderM = Model->topMatrix();
 			Model->popMatrix();
-			simple->unbind();
 
+			if (GameObject::cull) {
+				vector<GameObject *> objects;
+				for (auto obj : physicsObjects) {
+					objects.push_back(obj.get());
+				}
+				for (auto obj : props) {
+					objects.push_back(obj.get());
+				}
+				frustumCuller.build(objects);
+				frustumCuller.cull(lastProjection * lastView);
+
+				// the spider is the only large mesh in the scene
+				if (occlusionCulling) {
+					occlusionCuller.begin(lastProjection * lastView);
+					for (auto part : spiderBatched.empty() ? spider : spiderBatched) {
+						occlusionCuller.addOccluder(*part, spiderM);
+					}
+					occlusionCuller.rasterize();
+					occlusionCuller.cull(objects);
+				}
+			}
+			sphereInstances.clear();
 			for (auto obj : physicsObjects) {
-				obj->draw(simple, Model);
+				addPickable(obj.get(), PICK_PHYSICS);
+				ColliderSphere *collider = dynamic_cast<ColliderSphere *>(obj->getCollider().get());
+				if (sphereImpostors && collider != nullptr) {
+					if ((obj->inView || !GameObject::cull) && !obj->hidden) {
+						float radius = collider->radius * obj->scale.x;
+						sphereInstances.add(translate(mat4(1), obj->position) * glm::scale(mat4(1), vec3(radius)),
+							vec4(0.5, 0.4, 0.3, 1));
+					}
+					continue;
+				}
+				obj->draw(renderQueue, simple, Model);
+			}
+			renderQueue.submitInstanced(shaderManager->shaderMap[SPHEREPROG].get(), Shape::unitQuad().get(), &sphereInstances);
+			// far bunnies go into one instanced draw of billboards after the queue
+			bunnyImpostor.clear();
+			for (auto obj : props) {
+				addPickable(obj.get(), PICK_PROP);
+				if (useImpostors && bunnyImpostor.isBaked() && obj->model == bunny
+					&& length(obj->position - cameraPos) > impostorDistance) {
+					if ((obj->inView || !GameObject::cull) && !obj->hidden) {
+						bunnyImpostor.add(obj->getModelMatrix());
+					}
+					continue;
+				}
+				obj->draw(renderQueue, simple, Model);
 			}
     }
 
-	void updatePhysics(float dt) {
-		for (int i = 0; i < physicsObjects.size(); i++) {
-			for (int j = i + 1; j < physicsObjects.size(); j++) {
-				physicsObjects[i]->checkCollision(physicsObjects[j].get());
+	// registers what GameObject::draw would draw, whichever way it ends up drawn
+	void addPickable(GameObject *obj, PickID id) {
+		if (obj->model != nullptr && (obj->inView || !GameObject::cull) && !obj->hidden) {
+			picker.add(obj->model, obj->getModelMatrix(), id, obj);
+		}
+	}
+
+	void stepPhysics() {
+		PHYSICS_BEGIN_STEP(physicsStep);
+		for (auto obj : physicsObjects) {
+			obj->updateLOD(cameraPos);
+			obj->beginStep();
+		}
+		{
+			PHYSICS_TIMER(PHASE_PAIRS);
+			for (int i = 0; i < physicsObjects.size(); i++) {
+				for (int j = i + 1; j < physicsObjects.size(); j++) {
+					PHYSICS_COUNT(pairsConsidered, 1);
+					// pairs where neither body is integrated this tick can wait
+					if (!physicsObjects[i]->isStepping() && !physicsObjects[j]->isStepping()) {
+						PHYSICS_COUNT(pairsCulled, 1);
+						continue;
+					}
+					physicsObjects[i]->checkCollision(physicsObjects[j].get());
+				}
 			}
 		}
 		for (auto obj : physicsObjects) {
-			obj->update();
+			if (obj->isStepping()) {
+				obj->update();
+			}
+			else {
+				obj->clearCollisions();
+			}
+		}
+		PHYSICS_END_STEP();
+		physicsStep++;
+		sceneQueryDirty = true;
+	}
+
+	void updatePhysics(float dt) {
+		auto start = chrono::high_resolution_clock::now();
+		if (physicsStep == 0) {
+			physicsHistory.record(physicsStep, physicsObjects);
+		}
+		stepPhysics();
+		physicsHistory.record(physicsStep, physicsObjects);
+
+		float ms = chrono::duration_cast<std::chrono::microseconds>(
+			chrono::high_resolution_clock::now() - start).count() * 0.001f;
+		physicsStepTime = physicsStepTime == 0 ? ms : physicsStepTime * 0.95f + ms * 0.05f;
+	}
+
+	// Jump the simulation to the given step. Restores the closest snapshot
+	// at or before it and re-simulates the remaining (< interval) steps.
+	void seekPhysics(int step) {
+		step = std::max(step, 0);
+		int snapshot = physicsHistory.findSnapshot(step);
+		if (snapshot >= 0 && (step < physicsStep || snapshot > physicsStep)) {
+			int restored = physicsHistory.restore(step, physicsObjects);
+			if (restored >= 0) {
+				physicsStep = restored;
+				sceneQueryDirty = true;
+			}
+		}
+		// re-simulation doesn't record, the snapshots ahead are still valid
+		while (physicsStep < step) {
+			stepPhysics();
 		}
 	}
 };
@@ -539,10 +1019,39 @@ int main(int argc, char *argv[])
 {
 	// Where the resources are loaded from
 	std::string resourceDir = "../resources";
-
-	if (argc >= 2)
+	bool usePrimitives = false;
+#ifdef PREVIZ_CACHE_DIR
+	std::string cacheDir = PREVIZ_CACHE_DIR;
+#else
+	std::string cacheDir;
+#endif
+
+	for (int i = 1; i < argc; i++)
 	{
-		resourceDir = argv[1];
+		// --compact uploads meshes with the quantized interleaved vertex format
+		if (std::string(argv[i]) == "--compact")
+		{
+			Shape::compactVertices = true;
+		}
+		// --overdraw also orders triangles outside in when meshes are loaded
+		else if (std::string(argv[i]) == "--overdraw")
+		{
+			Shape::overdrawOrder = true;
+		}
+		// --primitives generates the sphere meshes instead of loading the OBJ files
+		else if (std::string(argv[i]) == "--primitives")
+		{
+			usePrimitives = true;
+		}
+		// --cache <dir> keeps baked data there, "" turns the cache off
+		else if (std::string(argv[i]) == "--cache" && i + 1 < argc)
+		{
+			cacheDir = argv[++i];
+		}
+		else
+		{
+			resourceDir = argv[i];
+		}
 	}
 
 	Application *application = new Application();
@@ -558,9 +1067,23 @@ int main(int argc, char *argv[])
 	// This is the code that will likely change program to program as you
 	// may need to initialize or set up different data and state
 
+	auto startup = chrono::high_resolution_clock::now();
+	application->usePrimitives = usePrimitives;
+	MeshCache::shared().setBakeCacheDirectory(cacheDir);
 	application->init(resourceDir);
 	application->initGeom(resourceDir);
+	cout << "Startup: " << chrono::duration<double, milli>(chrono::high_resolution_clock::now() - startup).count()
+		<< " ms (" << (usePrimitives ? "generated" : "OBJ") << " spheres)" << endl;
 	//application->initPhysicsObjects();
+	cout << "Mesh buffers: " << Shape::gpuMemoryTotal / 1024 << " KB ("
+		<< (Shape::compactVertices ? "compact" : "float") << " vertices)" << endl;
+	cout << "Mesh cache: " << MeshCache::shared().getNumAssets() << " assets, "
+		<< MeshCache::shared().getHits() << " hits, "
+		<< MeshCache::shared().getSavedBytes() / 1024 << " KB saved" << endl;
+	const MeshOptimizer::CacheStats &before = MeshCache::shared().getCacheBefore();
+	const MeshOptimizer::CacheStats &after = MeshCache::shared().getCacheAfter();
+	cout << "Vertex cache (16 entry FIFO): ACMR " << before.acmr() << " -> " << after.acmr()
+		<< ", ATVR " << before.atvr() << " -> " << after.atvr() << endl;
 
 	auto lastTime = chrono::high_resolution_clock::now();
 	float accumulator = 0.0f;
@@ -601,7 +1124,8 @@ int main(int argc, char *argv[])
 		glfwPollEvents();
 	}
 
-	// Quit program.
+	// Quit program. GL objects held by statics go while there is still a context.
+	Shape::releaseUnitQuad();
 	windowManager->shutdown();
 	return 0;
 }
\ No newline at end of file
@@ -3,8 +3,12 @@
 #include "ColliderSphere.h"
 #include "ColliderMesh.h"
 #include "PhysicsObject.h"
+#include "PhysicsStats.h"
 #include "../MatrixStack.h"
 
+// narrow phase tests timed, the rest are assumed to cost the same on average
+static const unsigned NARROW_SAMPLE_RATE = 16;
+
 Collider::Collider(vec3 min, vec3 max) :
     bbox(min, max)
 {
@@ -22,6 +26,9 @@ void Collider::clearCollisions(PhysicsObject *owner)
 
 void checkSphereSphere(PhysicsObject *sphere1, ColliderSphere *sphereCol1, PhysicsObject *sphere2, ColliderSphere *sphereCol2)
 {
+    PHYSICS_SAMPLED_TIMER(PHASE_NARROW, NARROW_SAMPLE_RATE);
+    PHYSICS_COUNT(spheresTested, 1);
+
     float d = distance(sphere1->position, sphere2->position);
     if (d < sphere1->getRadius() + sphere2->getRadius())
     {
@@ -40,6 +47,7 @@ void checkSphereSphere(PhysicsObject *sphere1, ColliderSphere *sphereCol1, Physi
         collision2.geom = SPHERE;
         collision2.pos = collision1.pos;
         sphereCol2->pendingCollisions.push_back(collision2);
+        PHYSICS_COUNT(contactsGenerated, 2);
     }
 }
 
@@ -47,15 +55,21 @@ void checkSphereSphere(PhysicsObject *sphere1, ColliderSphere *sphereCol1, Physi
 
 void checkSphereMesh(PhysicsObject *sphere, ColliderSphere *sphereCol, PhysicsObject *mesh, ColliderMesh *meshCol)
 {
+    PHYSICS_SAMPLED_TIMER(PHASE_NARROW, NARROW_SAMPLE_RATE);
 
     // Check bounding spheres
-    if (distance2(sphere->getCenterPos(), mesh->getCenterPos()) <= pow(sphere->getRadius() + mesh->getRadius(), 2))
+    if (distance2(sphere->getCenterPos(), mesh->getCenterPos()) > pow(sphere->getRadius() + mesh->getRadius(), 2))
+    {
+        PHYSICS_COUNT(pairsCulled, 1);
+    }
+    else
     {
         mat4 M = translate(mat4(1.f), mesh->position) * mat4_cast(mesh->orientation) * scale(mat4(1.f), mesh->scale);
 
         unordered_set<Edge, EdgeHash> edgeSet;
         unordered_set<vec3> vertSet;
         // Check faces
+        PHYSICS_COUNT(trianglesTested, meshCol->mesh->getNumFaces());
         for (int i = 0; i < meshCol->mesh->getNumFaces(); i++)
         {
             vector<vec3> v = meshCol->mesh->getFace(i, M);
@@ -79,6 +93,7 @@ void checkSphereMesh(PhysicsObject *sphere, ColliderSphere *sphereCol, PhysicsOb
                 collision.v[2] = v[2];
                 collision.pos = sphere->position + collision.normal * d;
                 sphereCol->pendingCollisions.push_back(collision);
+                PHYSICS_COUNT(contactsGenerated, 1);
 
                 // add edges of triangle to set of edges we shouldn't check
                 edgeSet.insert(Edge(v[0], v[1]));
@@ -97,6 +112,7 @@ void checkSphereMesh(PhysicsObject *sphere, ColliderSphere *sphereCol, PhysicsOb
                 // skip edge if it's in the set
                 continue;
             }
+            PHYSICS_COUNT(edgesTested, 1);
 
             vec3 closestPoint = v[0] + proj(sphere->position - v[0], normalize(v[1] - v[0]));
             float d = distance(sphere->position, closestPoint);
@@ -111,6 +127,7 @@ void checkSphereMesh(PhysicsObject *sphere, ColliderSphere *sphereCol, PhysicsOb
                 collision.geom = EDGE;
                 collision.pos = closestPoint;
                 sphereCol->pendingCollisions.push_back(collision);
+                PHYSICS_COUNT(contactsGenerated, 1);
 
                 // add vertices of edge to set of vertices we souldn't check 
                 vertSet.insert(v[0]);
@@ -128,6 +145,7 @@ void checkSphereMesh(PhysicsObject *sphere, ColliderSphere *sphereCol, PhysicsOb
                 // skip vertex if it's in the set
                 continue;
             }
+            PHYSICS_COUNT(verticesTested, 1);
 
             float d = distance(sphere->position, v);
             if (d < sphere->getRadius())
@@ -139,6 +157,7 @@ void checkSphereMesh(PhysicsObject *sphere, ColliderSphere *sphereCol, PhysicsOb
                 collision.geom = VERT;
                 collision.pos = v;
                 sphereCol->pendingCollisions.push_back(collision);
+                PHYSICS_COUNT(contactsGenerated, 1);
             }
         }
     }
@@ -1,5 +1,8 @@
 #include "GameObject.h"
 
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
 GameObject::GameObject(vec3 position, shared_ptr<Shape> model) : GameObject::GameObject(position, quat(1, 0, 0, 0), vec3(1, 1, 1), model) {}
 
 GameObject::GameObject(vec3 position, quat orientation, shared_ptr<Shape> model) : GameObject::GameObject(position, orientation, vec3(1, 1, 1), model) {}
@@ -12,9 +15,11 @@ GameObject::GameObject(vec3 position, quat orientation, vec3 scale, shared_ptr<S
     this->model = model;
     this->inView = true;
     this->hidden = false;
+    this->material = 0;
+    this->lod = 0;
 }
 
-void GameObject::draw(shared_ptr<Program> prog, shared_ptr<MatrixStack> M)
+void GameObject::draw(RenderQueue &queue, shared_ptr<Program> prog, shared_ptr<MatrixStack> M)
 {
     if (model != NULL && (inView || !cull) && !hidden)
     {
@@ -22,13 +27,52 @@ void GameObject::draw(shared_ptr<Program> prog, shared_ptr<MatrixStack> M)
             M->translate(position);
             M->rotate(orientation);
             M->scale(scale);
-            glUniformMatrix4fv(prog->getUniform("M"), 1, GL_FALSE, value_ptr(M->topMatrix()));
-            model->draw(prog);
+            if (useLOD)
+            {
+                selectLOD(queue, M->topMatrix());
+            }
+            queue.submit(prog.get(), model.get(), M->topMatrix(), material, PASS_OPAQUE, useLOD ? lod : 0);
         M->popMatrix();
     }
 }
 
+mat4 GameObject::getModelMatrix() const
+{
+    return translate(mat4(1), position) * mat4_cast(orientation) * glm::scale(mat4(1), scale);
+}
+
+// Screen size (fraction of the viewport height) below which level i + 1 is
+// used. An object has to get HYSTERESIS past a threshold before it switches,
+// so one sitting on a threshold doesn't flicker between levels.
+static const float LOD_SCREEN_SIZES[] = {0.3f, 0.15f, 0.06f};
+static const float HYSTERESIS = 0.15f;
+
+void GameObject::selectLOD(const RenderQueue &queue, const mat4 &M)
+{
+    vec3 center = vec3(M * vec4((model->min + model->max) * 0.5f, 1));
+    float scaleMax = (std::max)((std::max)(length(vec3(M[0])), length(vec3(M[1]))), length(vec3(M[2])));
+    float radius = length(model->max - model->min) * 0.5f * scaleMax;
+    float size = queue.getScreenSize(center, radius);
+
+    int levels = (std::min)(model->getNumLODs(), 4);
+    lod = (std::min)(lod, levels - 1);
+    while (lod + 1 < levels && size < LOD_SCREEN_SIZES[lod] * (1 - HYSTERESIS))
+    {
+        lod++;
+    }
+    while (lod > 0 && size > LOD_SCREEN_SIZES[lod - 1] * (1 + HYSTERESIS))
+    {
+        lod--;
+    }
+}
+
 bool GameObject::cull = false;
+bool GameObject::useLOD = false;
+
+void GameObject::setLOD(bool useLOD)
+{
+    GameObject::useLOD = useLOD;
+}
 
 void GameObject::setCulling(bool cull)
 {
@@ -7,6 +7,7 @@
 #include "../Program.h"
 #include "../Shape.h"
 #include "../MatrixStack.h"
+#include "../RenderQueue.h"
 #include "Collider.h"
 
 using namespace std;
@@ -20,8 +21,11 @@ public:
     GameObject(vec3 position, quat orientation, shared_ptr<Shape> model);
     GameObject(vec3 position, quat orientation, vec3 scale, shared_ptr<Shape> model);
     virtual void update() {};
-    virtual void draw(shared_ptr<Program> prog, shared_ptr<MatrixStack> M);
+    virtual void draw(RenderQueue &queue, shared_ptr<Program> prog, shared_ptr<MatrixStack> M);
+    mat4 getModelMatrix() const; // translate * rotate * scale, as draw() builds it
+    void selectLOD(const RenderQueue &queue, const mat4 &M); // updates lod from the screen size
     static void setCulling(bool cull);
+    static void setLOD(bool useLOD);
 
     vec3 position;
     quat orientation;
@@ -30,6 +34,8 @@ public:
     int material;
     bool inView;
     bool hidden;
+    int lod; // level drawn last frame, see Shape::buildLODs
 
     static bool cull;
+    static bool useLOD;
 };
\ No newline at end of file
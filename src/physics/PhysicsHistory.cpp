@@ -0,0 +1,274 @@
+#include "PhysicsHistory.h"
+
+#include <cstring>
+
+static size_t wordsFor(size_t bytes)
+{
+    return (bytes + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+}
+
+PhysicsHistory::PhysicsHistory(int interval, int keyframeInterval) :
+    interval((std::max)(interval, 1)), keyframeInterval((std::max)(keyframeInterval, 1)), cachedIndex(0)
+{
+}
+
+void PhysicsHistory::clear()
+{
+    snapshots.clear();
+    previous.clear();
+    cached.clear();
+    cachedIndex = 0;
+}
+
+void PhysicsHistory::capture(const vector<shared_ptr<PhysicsObject>> &objects, vector<uint32_t> &raw) const
+{
+    size_t n = objects.size();
+    size_t numContacts = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        vector<Collision> *pending = objects[i]->getPendingCollisions();
+        numContacts += pending != nullptr ? pending->size() : 0;
+    }
+
+    size_t bytes = n * sizeof(BodyState) + n * sizeof(uint32_t) + numContacts * sizeof(Collision);
+    raw.assign(wordsFor(bytes), 0);
+
+    char *bodies = (char *)raw.data();
+    char *counts = bodies + n * sizeof(BodyState);
+    char *contacts = counts + n * sizeof(uint32_t);
+
+    BodyState state;
+    for (size_t i = 0; i < n; i++)
+    {
+        objects[i]->saveState(state);
+        memcpy(bodies + i * sizeof(BodyState), &state, sizeof(BodyState));
+
+        vector<Collision> *pending = objects[i]->getPendingCollisions();
+        uint32_t count = pending != nullptr ? (uint32_t)pending->size() : 0;
+        memcpy(counts + i * sizeof(uint32_t), &count, sizeof(uint32_t));
+        if (count > 0)
+        {
+            memcpy(contacts, pending->data(), count * sizeof(Collision));
+            contacts += count * sizeof(Collision);
+        }
+    }
+}
+
+void PhysicsHistory::apply(const vector<uint32_t> &raw, const vector<shared_ptr<PhysicsObject>> &objects) const
+{
+    size_t n = objects.size();
+    const char *bodies = (const char *)raw.data();
+    const char *counts = bodies + n * sizeof(BodyState);
+    const char *contacts = counts + n * sizeof(uint32_t);
+
+    BodyState state;
+    for (size_t i = 0; i < n; i++)
+    {
+        memcpy(&state, bodies + i * sizeof(BodyState), sizeof(BodyState));
+        objects[i]->loadState(state);
+
+        uint32_t count;
+        memcpy(&count, counts + i * sizeof(uint32_t), sizeof(uint32_t));
+        // bodies without a collider are always captured with no contacts
+        vector<Collision> *pending = objects[i]->getPendingCollisions();
+        if (pending == nullptr)
+        {
+            continue;
+        }
+        pending->resize(count);
+        if (count > 0)
+        {
+            memcpy(pending->data(), contacts, count * sizeof(Collision));
+            contacts += count * sizeof(Collision);
+        }
+    }
+}
+
+// Run-length encoding of a word stream: pairs of [zero run][literal count]
+// followed by the literal words. When `base` is given the input is XOR'd
+// against it first, so unchanged words become zero runs.
+void PhysicsHistory::encode(const vector<uint32_t> &raw, const vector<uint32_t> *base, vector<uint32_t> &out)
+{
+    out.clear();
+    size_t i = 0;
+    size_t n = raw.size();
+    while (i < n)
+    {
+        uint32_t zeros = 0;
+        while (i < n && (raw[i] ^ (base ? (*base)[i] : 0)) == 0)
+        {
+            zeros++;
+            i++;
+        }
+
+        size_t header = out.size();
+        out.push_back(zeros);
+        out.push_back(0);
+
+        uint32_t literals = 0;
+        while (i < n)
+        {
+            uint32_t w = raw[i] ^ (base ? (*base)[i] : 0);
+            // end the literal run at the first pair of zero words
+            if (w == 0 && i + 1 < n && (raw[i + 1] ^ (base ? (*base)[i + 1] : 0)) == 0)
+            {
+                break;
+            }
+            out.push_back(w);
+            literals++;
+            i++;
+        }
+        out[header + 1] = literals;
+    }
+}
+
+void PhysicsHistory::expand(const vector<uint32_t> &in, size_t rawWords, bool keyframe, vector<uint32_t> &raw)
+{
+    if (keyframe)
+    {
+        raw.assign(rawWords, 0);
+    }
+
+    size_t pos = 0;
+    size_t i = 0;
+    while (i + 1 < in.size())
+    {
+        pos += in[i];
+        uint32_t literals = in[i + 1];
+        i += 2;
+        for (uint32_t j = 0; j < literals; j++)
+        {
+            raw[pos++] ^= in[i++];
+        }
+    }
+}
+
+void PhysicsHistory::record(int step, const vector<shared_ptr<PhysicsObject>> &objects)
+{
+    if (step % interval != 0)
+    {
+        return;
+    }
+
+    // timeline was rewritten (e.g. after a seek), later snapshots are stale
+    if (!snapshots.empty() && step <= snapshots.back().step)
+    {
+        while (!snapshots.empty() && snapshots.back().step >= step)
+        {
+            snapshots.pop_back();
+        }
+        cached.clear();
+        previous.clear();
+        if (!snapshots.empty())
+        {
+            decode(snapshots.size() - 1, previous);
+        }
+    }
+
+    capture(objects, scratch);
+
+    Snapshot snapshot;
+    snapshot.step = step;
+    snapshot.numObjects = (uint32_t)objects.size();
+    snapshot.rawWords = scratch.size();
+    snapshot.keyframe = snapshots.empty() ||
+        snapshots.size() % keyframeInterval == 0 ||
+        previous.size() != scratch.size() ||
+        snapshots.back().numObjects != snapshot.numObjects;
+
+    encode(scratch, snapshot.keyframe ? nullptr : &previous, snapshot.data);
+    snapshot.data.shrink_to_fit();
+    snapshots.push_back(snapshot);
+
+    previous.swap(scratch);
+}
+
+bool PhysicsHistory::decode(size_t index, vector<uint32_t> &raw)
+{
+    size_t key = index;
+    while (!snapshots[key].keyframe)
+    {
+        key--;
+    }
+
+    size_t start = key;
+    if (!cached.empty() && cachedIndex >= key && cachedIndex <= index)
+    {
+        // continue from the cached snapshot instead of the keyframe
+        raw = cached;
+        start = cachedIndex + 1;
+    }
+    else
+    {
+        expand(snapshots[key].data, snapshots[key].rawWords, true, raw);
+        start = key + 1;
+    }
+
+    for (size_t i = start; i <= index; i++)
+    {
+        if (snapshots[i].rawWords != raw.size())
+        {
+            return false;
+        }
+        expand(snapshots[i].data, snapshots[i].rawWords, false, raw);
+    }
+
+    cached = raw;
+    cachedIndex = index;
+    return true;
+}
+
+int PhysicsHistory::findIndex(int step) const
+{
+    // newest snapshot at or before the requested step
+    for (int i = (int)snapshots.size() - 1; i >= 0; i--)
+    {
+        if (snapshots[i].step <= step)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int PhysicsHistory::findSnapshot(int step) const
+{
+    int index = findIndex(step);
+    return index < 0 ? -1 : snapshots[index].step;
+}
+
+int PhysicsHistory::restore(int step, const vector<shared_ptr<PhysicsObject>> &objects)
+{
+    int index = findIndex(step);
+    if (index < 0 || snapshots[index].numObjects != objects.size())
+    {
+        return -1;
+    }
+
+    if (!decode(index, scratch))
+    {
+        return -1;
+    }
+    apply(scratch, objects);
+    return snapshots[index].step;
+}
+
+size_t PhysicsHistory::getMemoryUsage() const
+{
+    size_t bytes = 0;
+    for (const Snapshot &snapshot : snapshots)
+    {
+        bytes += snapshot.data.size() * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+size_t PhysicsHistory::getRawSize() const
+{
+    size_t bytes = 0;
+    for (const Snapshot &snapshot : snapshots)
+    {
+        bytes += snapshot.rawWords * sizeof(uint32_t);
+    }
+    return bytes;
+}
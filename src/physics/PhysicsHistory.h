@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "PhysicsObject.h"
+
+using namespace std;
+
+// Records the state of every physics object every `interval` steps so the
+// simulation can be scrubbed backwards without restarting from t=0.
+//
+// A snapshot is one flat buffer laid out as
+//   [BodyState x N][uint32 contact count x N][Collision x total contacts]
+// which is filled with straight memcpys. Each snapshot is stored XOR'd
+// against the one before it and run-length encoded (most of a settled world
+// does not change between snapshots), with a full keyframe every
+// `keyframeInterval` snapshots to bound the decode chain.
+//
+// Seeking to step S restores the newest snapshot at or before S, so at most
+// `interval - 1` steps have to be re-simulated.
+class PhysicsHistory
+{
+public:
+    PhysicsHistory(int interval = 10, int keyframeInterval = 8);
+
+    // Call once per physics step, after the step. Only every `interval`th
+    // step is captured. Recording a step at or before the newest snapshot
+    // means the timeline was rewritten, so later snapshots are dropped.
+    void record(int step, const vector<shared_ptr<PhysicsObject>> &objects);
+
+    // Restores the newest snapshot at or before `step` into `objects`.
+    // Returns the step of the restored snapshot, or -1 if there is none
+    // (or the set of objects changed since it was taken).
+    int restore(int step, const vector<shared_ptr<PhysicsObject>> &objects);
+
+    // Step of the snapshot restore() would use, or -1.
+    int findSnapshot(int step) const;
+
+    void clear();
+    int getInterval() const { return interval; }
+    size_t getNumSnapshots() const { return snapshots.size(); }
+    size_t getMemoryUsage() const; // bytes of encoded snapshot data
+    size_t getRawSize() const; // bytes the same snapshots would take uncompressed
+
+private:
+    struct Snapshot
+    {
+        int step;
+        bool keyframe;
+        uint32_t numObjects;
+        size_t rawWords;
+        vector<uint32_t> data; // run-length encoded (XOR delta unless keyframe)
+    };
+
+    void capture(const vector<shared_ptr<PhysicsObject>> &objects, vector<uint32_t> &raw) const;
+    void apply(const vector<uint32_t> &raw, const vector<shared_ptr<PhysicsObject>> &objects) const;
+    bool decode(size_t index, vector<uint32_t> &raw);
+    int findIndex(int step) const;
+
+    static void encode(const vector<uint32_t> &raw, const vector<uint32_t> *base, vector<uint32_t> &out);
+    static void expand(const vector<uint32_t> &in, size_t rawWords, bool keyframe, vector<uint32_t> &raw);
+
+    int interval;
+    int keyframeInterval;
+    vector<Snapshot> snapshots;
+
+    vector<uint32_t> previous; // raw copy of the newest snapshot
+    vector<uint32_t> scratch;
+
+    // last decoded snapshot, so scrubbing back and forth doesn't re-walk the chain
+    size_t cachedIndex;
+    vector<uint32_t> cached;
+};
@@ -1,4 +1,5 @@
 #include "PhysicsObject.h"
+#include "PhysicsStats.h"
 
 bool inRange(float n, float low, float high)
 {
@@ -26,56 +27,69 @@ PhysicsObject::PhysicsObject(vec3 position, quat orientation, vec3 scale, shared
     this->speed = 0;
     this->ignoreCollision = false;
     this->solid = true;
+    this->simLOD = SIM_FULL;
+    this->stepsSinceUpdate = 0;
+    this->stepping = true;
+    this->stepDelta = Time.physicsDeltaTime;
+    this->importance = 1;
 }
 
 void PhysicsObject::update()
 {
+    PHYSICS_COUNT(bodiesIntegrated, 1);
+
     normForce = vec3(0);
     netForce.y += GRAVITY * mass;
 
     // filter collisions so that objects don't bump over edges
-    vector<Collision *> faceCollisions;
-    vector<Collision *> notFaceCollisions;
-    for (int i = 0; i < collider->pendingCollisions.size(); i++)
     {
-        switch (collider->pendingCollisions[i].geom)
+        PHYSICS_TIMER(PHASE_FILTER);
+        vector<Collision *> faceCollisions;
+        vector<Collision *> notFaceCollisions;
+        for (int i = 0; i < collider->pendingCollisions.size(); i++)
         {
-            case FACE:
-                faceCollisions.push_back(&collider->pendingCollisions[i]);
-                break;
-            case EDGE:
-            case VERT:
-                notFaceCollisions.push_back(&collider->pendingCollisions[i]);
-                break;
+            switch (collider->pendingCollisions[i].geom)
+            {
+                case FACE:
+                    faceCollisions.push_back(&collider->pendingCollisions[i]);
+                    break;
+                case EDGE:
+                case VERT:
+                    notFaceCollisions.push_back(&collider->pendingCollisions[i]);
+                    break;
+            }
         }
-    }
-    unordered_set<Collision *> collisionsToRemove;
-    for (int i = 0; i < faceCollisions.size(); i++)
-    {
-        for (int j = 0; j < notFaceCollisions.size(); j++)
+        unordered_set<Collision *> collisionsToRemove;
+        for (int i = 0; i < faceCollisions.size(); i++)
         {
-            if (faceCollisions[i]->other != notFaceCollisions[j]->other)
+            for (int j = 0; j < notFaceCollisions.size(); j++)
             {
-                float d;
-                intersectRayPlane(notFaceCollisions[j]->pos, -faceCollisions[i]->normal,
-                    faceCollisions[i]->v[0], faceCollisions[i]->normal, d);
-                if (d < 0.1)
+                if (faceCollisions[i]->other != notFaceCollisions[j]->other)
                 {
-                    collisionsToRemove.insert(notFaceCollisions[j]);
+                    float d;
+                    intersectRayPlane(notFaceCollisions[j]->pos, -faceCollisions[i]->normal,
+                        faceCollisions[i]->v[0], faceCollisions[i]->normal, d);
+                    if (d < 0.1)
+                    {
+                        collisionsToRemove.insert(notFaceCollisions[j]);
+                    }
                 }
             }
         }
-    }
-    for (size_t i = collider->pendingCollisions.size() - 1; i >= 0 && !collisionsToRemove.empty(); i--)
-    {
-        Collision *col = &collider->pendingCollisions[i];
-        if (collisionsToRemove.find(col) != collisionsToRemove.end())
+        for (size_t i = collider->pendingCollisions.size() - 1; i >= 0 && !collisionsToRemove.empty(); i--)
         {
-            collisionsToRemove.erase(col);
-            collider->pendingCollisions.erase(collider->pendingCollisions.begin() + i);
+            Collision *col = &collider->pendingCollisions[i];
+            if (collisionsToRemove.find(col) != collisionsToRemove.end())
+            {
+                collisionsToRemove.erase(col);
+                collider->pendingCollisions.erase(collider->pendingCollisions.begin() + i);
+                PHYSICS_COUNT(contactsRemoved, 1);
+            }
         }
     }
 
+    PHYSICS_TIMER(PHASE_INTEGRATE);
+
     float maxImpact = -1;
     Collision maxImpactCollision;
     for (Collision collision : collider->pendingCollisions)
@@ -148,24 +162,99 @@ void PhysicsObject::update()
 
     // apply force
     acceleration = netForce * invMass;
-    velocity += acceleration * Time.physicsDeltaTime;
+    velocity += acceleration * stepDelta;
     if (fabs(velocity.x) > 0.01)
     {
-        position.x += velocity.x * Time.physicsDeltaTime;
+        position.x += velocity.x * stepDelta;
     }
     if (fabs(velocity.y) > 0.01)
     {
-        position.y += velocity.y * Time.physicsDeltaTime;
+        position.y += velocity.y * stepDelta;
     }
     if (fabs(velocity.z) > 0.01)
     {
-        position.z += velocity.z * Time.physicsDeltaTime;
+        position.z += velocity.z * stepDelta;
     }
 
     impulse = vec3(0);
     netForce = vec3(0);
 }
 
+bool PhysicsObject::simLODEnabled = false;
+float PhysicsObject::simLODDistances[3] = {10.0f, 25.0f, 50.0f};
+
+void PhysicsObject::setSimLOD(bool enabled)
+{
+    PhysicsObject::simLODEnabled = enabled;
+}
+
+SimLOD PhysicsObject::getLOD()
+{
+    return simLOD;
+}
+
+bool PhysicsObject::isStepping()
+{
+    return stepping;
+}
+
+void PhysicsObject::updateLOD(vec3 cameraPos)
+{
+    SimLOD lod = SIM_FULL;
+    if (simLODEnabled)
+    {
+        float d = distance(cameraPos, getCenterPos()) / (std::max)(importance, 0.001f);
+
+        // 10% hysteresis so bodies near a threshold don't flip every tick
+        const float band = 0.1f;
+        lod = SIM_FROZEN;
+        for (int i = 0; i < 3; i++)
+        {
+            float threshold = simLODDistances[i] * (i < (int)simLOD ? 1 - band : 1 + band);
+            if (d < threshold)
+            {
+                lod = (SimLOD)i;
+                break;
+            }
+        }
+    }
+
+    if (lod != simLOD && lod == SIM_FROZEN)
+    {
+        // velocity is kept as is, the body resumes with the same momentum
+        stepsSinceUpdate = 0;
+    }
+    else if (simLOD == SIM_FROZEN && lod != SIM_FROZEN)
+    {
+        // time spent frozen is not integrated, start a fresh step
+        stepsSinceUpdate = 0;
+    }
+    simLOD = lod;
+}
+
+// Decides whether the body is integrated on this tick. Ticks skipped at a
+// reduced rate are folded into the next integration step, so switching
+// levels never drops or duplicates simulated time.
+bool PhysicsObject::beginStep()
+{
+    static const int strides[3] = {1, 2, 4};
+
+    if (simLOD == SIM_FROZEN)
+    {
+        stepping = false;
+        return stepping;
+    }
+
+    stepsSinceUpdate++;
+    stepping = stepsSinceUpdate >= strides[simLOD];
+    if (stepping)
+    {
+        stepDelta = stepsSinceUpdate * Time.physicsDeltaTime;
+        stepsSinceUpdate = 0;
+    }
+    return stepping;
+}
+
 void PhysicsObject::start()
 {
 
@@ -192,6 +281,10 @@ void PhysicsObject::checkCollision(PhysicsObject *other)
     {
         collider->checkCollision(this, other, other->collider.get());
     }
+    else
+    {
+        PHYSICS_COUNT(pairsCulled, 1);
+    }
 }
 
 float PhysicsObject::getRadius()
@@ -264,10 +357,45 @@ vec3 PhysicsObject::getVelocity()
     return this->velocity;
 }
 
+shared_ptr<Collider> PhysicsObject::getCollider()
+{
+    return this->collider;
+}
+
 void PhysicsObject::clearCollisions()
 {
     if (collider != nullptr)
     {
         collider->clearCollisions(this);
     }
-}
\ No newline at end of file
+}
+void PhysicsObject::saveState(BodyState &state) const
+{
+    state.position = position;
+    state.orientation = orientation;
+    state.velocity = velocity;
+    state.acceleration = acceleration;
+    state.impulse = impulse;
+    state.normForce = normForce;
+    state.netForce = netForce;
+    state.simLOD = simLOD;
+    state.stepsSinceUpdate = stepsSinceUpdate;
+}
+
+void PhysicsObject::loadState(const BodyState &state)
+{
+    position = state.position;
+    orientation = state.orientation;
+    velocity = state.velocity;
+    acceleration = state.acceleration;
+    impulse = state.impulse;
+    normForce = state.normForce;
+    netForce = state.netForce;
+    simLOD = (SimLOD)state.simLOD;
+    stepsSinceUpdate = state.stepsSinceUpdate;
+}
+
+vector<Collision> *PhysicsObject::getPendingCollisions()
+{
+    return collider != nullptr ? &collider->pendingCollisions : nullptr;
+}
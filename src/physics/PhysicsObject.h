@@ -24,6 +24,26 @@
 using namespace std;
 using namespace glm;
 
+// Simulation level of detail. Reduced levels step every 2nd/4th physics
+// tick with a correspondingly larger time step, frozen bodies keep their
+// velocity but are not integrated until they come back into range.
+enum SimLOD {SIM_FULL, SIM_HALF, SIM_QUARTER, SIM_FROZEN};
+
+// Plain-old-data copy of everything that changes while a body is simulated.
+// Kept trivially copyable so a whole world can be memcpy'd into a snapshot.
+struct BodyState
+{
+    vec3 position;
+    quat orientation;
+    vec3 velocity;
+    vec3 acceleration;
+    vec3 impulse;
+    vec3 normForce;
+    vec3 netForce;
+    int simLOD;
+    int stepsSinceUpdate;
+};
+
 // https://gafferongames.com/post/physics_in_3d/
 class PhysicsObject : public GameObject
 {
@@ -43,6 +63,12 @@ protected:
     vec3 normForce;
     vec3 netForce; // net forces acting on ball, calculated each frame
 
+    // simulation LOD
+    SimLOD simLOD;
+    int stepsSinceUpdate; // physics ticks since this body was last integrated
+    bool stepping; // whether this body is integrated on the current tick
+    float stepDelta; // time step of the current integration
+
 public:
 	PhysicsObject();
     PhysicsObject(vec3 position, shared_ptr<Shape> model, shared_ptr<Collider> collider = nullptr);
@@ -50,7 +76,7 @@ public:
     PhysicsObject(vec3 position, quat orientation, vec3 scale, shared_ptr<Shape> model, shared_ptr<Collider> collider = nullptr);
 
     // standard interface
-    /* GameObject.h: virtual void draw(shared_ptr<Program> prog, shared_ptr<MatrixStack> M)); */
+    /* GameObject.h: virtual void draw(RenderQueue &queue, shared_ptr<Program> prog, shared_ptr<MatrixStack> M)); */
     virtual void start();
     virtual void update();
     virtual void lateUpdate();
@@ -68,6 +94,24 @@ public:
     void setVelocity(vec3 velocity);
     vec3 getCenterPos();
     vec3 getVelocity();
+    shared_ptr<Collider> getCollider();
+
+    // snapshot support (see PhysicsHistory)
+    void saveState(BodyState &state) const;
+    void loadState(const BodyState &state);
+    // nullptr for bodies without a collider
+    vector<Collision> *getPendingCollisions();
+
+    // simulation LOD, call beginStep() once per physics tick before collision checks
+    void updateLOD(vec3 cameraPos);
+    bool beginStep();
+    bool isStepping();
+    SimLOD getLOD();
+    static void setSimLOD(bool enabled);
+    float importance; // scales the distance thresholds, > 1 keeps a body at full rate further out
+
+    static bool simLODEnabled;
+    static float simLODDistances[3]; // full, half and quarter rate cut-offs
     bool ignoreCollision;
     bool solid;
 };
\ No newline at end of file
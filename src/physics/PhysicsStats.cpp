@@ -0,0 +1,143 @@
+#include "PhysicsStats.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+PhysicsStats &PhysicsStats::get()
+{
+    static PhysicsStats stats;
+    return stats;
+}
+
+const char *PhysicsStats::phaseName(int phase)
+{
+    static const char *names[NUM_PHYSICS_PHASES] = {"step", "pairs", "narrow", "filter", "integrate"};
+    return phase >= 0 && phase < NUM_PHYSICS_PHASES ? names[phase] : "unknown";
+}
+
+PhysicsStats::PhysicsStats() :
+    next(0)
+{
+    memset(&current, 0, sizeof(current));
+}
+
+void PhysicsStats::clear()
+{
+    history.clear();
+    next = 0;
+    memset(&current, 0, sizeof(current));
+}
+
+void PhysicsStats::beginStep(int step)
+{
+    memset(&current, 0, sizeof(current));
+    current.step = step;
+    stepStart = chrono::high_resolution_clock::now();
+}
+
+void PhysicsStats::endStep()
+{
+    current.phaseTime[PHASE_STEP] =
+        chrono::duration<double, milli>(chrono::high_resolution_clock::now() - stepStart).count();
+
+    // ring buffer of the most recent steps
+    if (history.size() < HISTORY_SIZE)
+    {
+        history.push_back(current);
+    }
+    else
+    {
+        history[next] = current;
+    }
+    next = (next + 1) % HISTORY_SIZE;
+}
+
+const PhysicsStepStats &PhysicsStats::last() const
+{
+    if (history.empty())
+    {
+        return current;
+    }
+    return history[(next + history.size() - 1) % history.size()];
+}
+
+void PhysicsStats::ordered(vector<PhysicsStepStats> &out) const
+{
+    out.clear();
+    size_t start = history.size() < HISTORY_SIZE ? 0 : next;
+    for (size_t i = 0; i < history.size(); i++)
+    {
+        out.push_back(history[(start + i) % history.size()]);
+    }
+}
+
+bool PhysicsStats::writeCSV(const string &path) const
+{
+    ofstream file(path);
+    if (!file.is_open())
+    {
+        cerr << "Could not open file: '" << path << "'" << endl;
+        return false;
+    }
+
+    file << "step,pairsConsidered,pairsCulled,trianglesTested,edgesTested,verticesTested,"
+        << "spheresTested,contactsGenerated,contactsRemoved,bodiesIntegrated";
+    for (int p = 0; p < NUM_PHYSICS_PHASES; p++)
+    {
+        file << "," << phaseName(p) << "Ms";
+    }
+    file << "\n";
+
+    vector<PhysicsStepStats> steps;
+    ordered(steps);
+    for (const PhysicsStepStats &s : steps)
+    {
+        file << s.step << "," << s.pairsConsidered << "," << s.pairsCulled << ","
+            << s.trianglesTested << "," << s.edgesTested << "," << s.verticesTested << ","
+            << s.spheresTested << "," << s.contactsGenerated << "," << s.contactsRemoved << ","
+            << s.bodiesIntegrated;
+        for (int p = 0; p < NUM_PHYSICS_PHASES; p++)
+        {
+            file << "," << s.phaseTime[p];
+        }
+        file << "\n";
+    }
+    return true;
+}
+
+bool PhysicsStats::writeJSON(const string &path) const
+{
+    ofstream file(path);
+    if (!file.is_open())
+    {
+        cerr << "Could not open file: '" << path << "'" << endl;
+        return false;
+    }
+
+    vector<PhysicsStepStats> steps;
+    ordered(steps);
+    file << "[\n";
+    for (size_t i = 0; i < steps.size(); i++)
+    {
+        const PhysicsStepStats &s = steps[i];
+        file << "  {\"step\": " << s.step
+            << ", \"pairsConsidered\": " << s.pairsConsidered
+            << ", \"pairsCulled\": " << s.pairsCulled
+            << ", \"trianglesTested\": " << s.trianglesTested
+            << ", \"edgesTested\": " << s.edgesTested
+            << ", \"verticesTested\": " << s.verticesTested
+            << ", \"spheresTested\": " << s.spheresTested
+            << ", \"contactsGenerated\": " << s.contactsGenerated
+            << ", \"contactsRemoved\": " << s.contactsRemoved
+            << ", \"bodiesIntegrated\": " << s.bodiesIntegrated
+            << ", \"timeMs\": {";
+        for (int p = 0; p < NUM_PHYSICS_PHASES; p++)
+        {
+            file << (p ? ", " : "") << "\"" << phaseName(p) << "\": " << s.phaseTime[p];
+        }
+        file << "}}" << (i + 1 < steps.size() ? "," : "") << "\n";
+    }
+    file << "]\n";
+    return true;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Per-step physics counters and phase timings.
+//
+// The physics code reports through the PHYSICS_* macros below,
+// which compile to nothing unless PHYSICS_STATS is defined (CMake option of
+// the same name). The PhysicsStats API itself is always available so tools
+// don't need their own #ifdefs, it just reports zeros when compiled out.
+
+enum PhysicsPhase
+{
+    PHASE_STEP,       // whole step
+    PHASE_PAIRS,      // pair loop, including the narrow phase below
+    PHASE_NARROW,     // sphere/sphere and sphere/mesh tests, sampled (see PHYSICS_SAMPLED_TIMER)
+    PHASE_FILTER,     // edge/vertex contact filter in PhysicsObject::update
+    PHASE_INTEGRATE,  // collision response and integration
+    NUM_PHYSICS_PHASES
+};
+
+struct PhysicsStepStats
+{
+    int step;
+    int pairsConsidered;
+    int pairsCulled; // skipped by LOD, ignoreCollision or bounding spheres
+    int trianglesTested;
+    int edgesTested;
+    int verticesTested;
+    int spheresTested;
+    int contactsGenerated;
+    int contactsRemoved; // by the contact filter
+    int bodiesIntegrated;
+    double phaseTime[NUM_PHYSICS_PHASES]; // milliseconds
+};
+
+class PhysicsStats
+{
+public:
+    static PhysicsStats &get();
+    static const char *phaseName(int phase);
+
+    // endStep() stores the step in the history and sets its PHASE_STEP time
+    void beginStep(int step);
+    void endStep();
+
+    const PhysicsStepStats &last() const;
+    const vector<PhysicsStepStats> &getHistory() const { return history; } // oldest first once full
+    void clear();
+
+    bool writeCSV(const string &path) const;
+    bool writeJSON(const string &path) const;
+
+    PhysicsStepStats current;
+
+private:
+    PhysicsStats();
+    void ordered(vector<PhysicsStepStats> &out) const;
+
+    static const size_t HISTORY_SIZE = 600;
+    vector<PhysicsStepStats> history;
+    size_t next;
+    chrono::high_resolution_clock::time_point stepStart;
+};
+
+class PhysicsScopedTimer
+{
+public:
+    PhysicsScopedTimer(PhysicsPhase phase) : phase(phase), start(chrono::high_resolution_clock::now()) {}
+    ~PhysicsScopedTimer()
+    {
+        PhysicsStats::get().current.phaseTime[phase] +=
+            chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+    }
+
+private:
+    PhysicsPhase phase;
+    chrono::high_resolution_clock::time_point start;
+};
+
+// Times one scope in every `rate` and counts it `rate` times, for scopes run
+// so often (once per pair) that two clock reads each would be most of the
+// time measured.
+class PhysicsSampledTimer
+{
+public:
+    PhysicsSampledTimer(PhysicsPhase phase, unsigned &counter, unsigned rate) :
+        phase(phase), rate(rate), sampled(counter++ % rate == 0)
+    {
+        if (sampled)
+        {
+            start = chrono::high_resolution_clock::now();
+        }
+    }
+    ~PhysicsSampledTimer()
+    {
+        if (sampled)
+        {
+            PhysicsStats::get().current.phaseTime[phase] += rate *
+                chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+        }
+    }
+
+private:
+    PhysicsPhase phase;
+    unsigned rate;
+    bool sampled;
+    chrono::high_resolution_clock::time_point start;
+};
+
+#define PHYSICS_CONCAT_INNER(a, b) a##b
+#define PHYSICS_CONCAT(a, b) PHYSICS_CONCAT_INNER(a, b)
+
+#ifdef PHYSICS_STATS
+#define PHYSICS_BEGIN_STEP(step) PhysicsStats::get().beginStep(step)
+#define PHYSICS_END_STEP() PhysicsStats::get().endStep()
+#define PHYSICS_COUNT(counter, n) (PhysicsStats::get().current.counter += (n))
+#define PHYSICS_TIMER(phase) PhysicsScopedTimer PHYSICS_CONCAT(physicsTimer, __LINE__)(phase)
+#define PHYSICS_SAMPLED_TIMER(phase, rate) static unsigned PHYSICS_CONCAT(physicsSamples, __LINE__) = 0; \
+    PhysicsSampledTimer PHYSICS_CONCAT(physicsTimer, __LINE__)(phase, PHYSICS_CONCAT(physicsSamples, __LINE__), rate)
+#else
+#define PHYSICS_BEGIN_STEP(step) ((void)0)
+#define PHYSICS_END_STEP() ((void)0)
+#define PHYSICS_COUNT(counter, n) ((void)0)
+#define PHYSICS_TIMER(phase) ((void)0)
+#define PHYSICS_SAMPLED_TIMER(phase, rate) ((void)0)
+#endif
@@ -0,0 +1,663 @@
+#include "SceneQuery.h"
+
+#include <chrono>
+#include <unordered_map>
+
+#include "ColliderMesh.h"
+#include "ColliderSphere.h"
+
+static const int QUERY_GRAIN = 64; // queries per worker chunk
+
+// Real-Time Collision Detection (Ericson), 5.1.5
+static vec3 closestPointOnTriangle(const vec3 &p, const vec3 &a, const vec3 &b, const vec3 &c)
+{
+    vec3 ab = b - a;
+    vec3 ac = c - a;
+    vec3 ap = p - a;
+    float d1 = dot(ab, ap);
+    float d2 = dot(ac, ap);
+    if (d1 <= 0 && d2 <= 0) return a;
+
+    vec3 bp = p - b;
+    float d3 = dot(ab, bp);
+    float d4 = dot(ac, bp);
+    if (d3 >= 0 && d4 <= d3) return b;
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0) return a + ab * (d1 / (d1 - d3));
+
+    vec3 cp = p - c;
+    float d5 = dot(ab, cp);
+    float d6 = dot(ac, cp);
+    if (d6 >= 0 && d5 <= d6) return c;
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0) return a + ac * (d2 / (d2 - d6));
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+    {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    float denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+static vec3 closestPointOnSegment(const vec3 &p, const vec3 &a, const vec3 &b)
+{
+    vec3 ab = b - a;
+    float len2 = dot(ab, ab);
+    float t = len2 > 0 ? clamp(dot(p - a, ab) / len2, 0.0f, 1.0f) : 0.0f;
+    return a + ab * t;
+}
+
+// Separating axis test between a triangle and a box (Akenine-Moller)
+static bool triangleBoxOverlap(const vec3 &center, const vec3 &half, const vec3 &a, const vec3 &b, const vec3 &c)
+{
+    vec3 v[3] = {a - center, b - center, c - center};
+    vec3 e[3] = {v[1] - v[0], v[2] - v[1], v[0] - v[2]};
+
+    // box face normals
+    for (int i = 0; i < 3; i++)
+    {
+        float lo = (std::min)(v[0][i], (std::min)(v[1][i], v[2][i]));
+        float hi = (std::max)(v[0][i], (std::max)(v[1][i], v[2][i]));
+        if (lo > half[i] || hi < -half[i]) return false;
+    }
+
+    // triangle normal
+    vec3 n = cross(e[0], e[1]);
+    float r = half.x * fabs(n.x) + half.y * fabs(n.y) + half.z * fabs(n.z);
+    if (fabs(dot(n, v[0])) > r) return false;
+
+    // edge x box axis
+    static const vec3 axes[3] = {vec3(1, 0, 0), vec3(0, 1, 0), vec3(0, 0, 1)};
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            vec3 axis = cross(axes[j], e[i]);
+            float p0 = dot(v[0], axis);
+            float p1 = dot(v[1], axis);
+            float p2 = dot(v[2], axis);
+            r = half.x * fabs(axis.x) + half.y * fabs(axis.y) + half.z * fabs(axis.z);
+            if ((std::min)(p0, (std::min)(p1, p2)) > r || (std::max)(p0, (std::max)(p1, p2)) < -r) return false;
+        }
+    }
+    return true;
+}
+
+// Ray against a sphere of radius r, dir normalized. t = 0 when the origin starts inside.
+static bool raySphere(const vec3 &origin, const vec3 &dir, const vec3 &center, float r, float &t)
+{
+    vec3 oc = origin - center;
+    float c = dot(oc, oc) - r * r;
+    if (c <= 0)
+    {
+        t = 0;
+        return true;
+    }
+    float b = dot(oc, dir);
+    float h = b * b - c;
+    if (b > 0 || h < 0)
+    {
+        return false;
+    }
+    t = -b - sqrt(h);
+    return true;
+}
+
+// Ray against a capsule around segment pa-pb (https://iquilezles.org/articles/intersectors)
+static bool rayCapsule(const vec3 &origin, const vec3 &dir, const vec3 &pa, const vec3 &pb, float r, float &t)
+{
+    vec3 ba = pb - pa;
+    vec3 oa = origin - pa;
+    float baba = dot(ba, ba);
+    float bard = dot(ba, dir);
+    float baoa = dot(ba, oa);
+    float rdoa = dot(dir, oa);
+    float oaoa = dot(oa, oa);
+    float a = baba - bard * bard;
+    float b = baba * rdoa - baoa * bard;
+    float c = baba * oaoa - baoa * baoa - r * r * baba;
+    float h = b * b - a * c;
+
+    if (a > 1e-8f && h >= 0)
+    {
+        t = (-b - sqrt(h)) / a;
+        float y = baoa + t * bard;
+        if (y > 0 && y < baba)
+        {
+            return t >= 0;
+        }
+    }
+
+    // end caps (also covers rays parallel to the segment)
+    float t0, t1;
+    bool hit0 = raySphere(origin, dir, pa, r, t0);
+    bool hit1 = raySphere(origin, dir, pb, r, t1);
+    if (!hit0 && !hit1)
+    {
+        return false;
+    }
+    t = hit0 && hit1 ? (std::min)(t0, t1) : (hit0 ? t0 : t1);
+    return true;
+}
+
+// Swept sphere against a triangle: the face, then the edge capsules (which include the corners)
+static bool sweepTriangle(const vec3 &origin, const vec3 &dir, float r, float maxT,
+    const vec3 &a, const vec3 &b, const vec3 &c, float &t, vec3 &normal)
+{
+    vec3 n = cross(b - a, c - a);
+    float len = length(n);
+    if (len <= 0)
+    {
+        return false;
+    }
+    n /= len;
+    if (dot(origin - a, n) < 0)
+    {
+        n = -n;
+    }
+
+    // already touching
+    vec3 q = closestPointOnTriangle(origin, a, b, c);
+    vec3 toOrigin = origin - q;
+    if (dot(toOrigin, toOrigin) < r * r)
+    {
+        t = 0;
+        normal = dot(toOrigin, toOrigin) > 0 ? normalize(toOrigin) : n;
+        return true;
+    }
+
+    bool hit = false;
+    float best = maxT;
+
+    float denom = dot(dir, n);
+    if (denom < 0)
+    {
+        float tp = (r - dot(origin - a, n)) / denom;
+        vec3 p = origin + dir * tp - n * r;
+        if (tp >= 0 && tp <= best &&
+            dot(cross(b - a, p - a), n) >= 0 &&
+            dot(cross(c - b, p - b), n) >= 0 &&
+            dot(cross(a - c, p - c), n) >= 0)
+        {
+            best = tp;
+            normal = n;
+            hit = true;
+        }
+    }
+
+    const vec3 *verts[3] = {&a, &b, &c};
+    for (int i = 0; i < 3; i++)
+    {
+        const vec3 &e0 = *verts[i];
+        const vec3 &e1 = *verts[(i + 1) % 3];
+        float te;
+        if (rayCapsule(origin, dir, e0, e1, r, te) && te < best)
+        {
+            best = te;
+            vec3 center = origin + dir * te;
+            normal = normalize(center - closestPointOnSegment(center, e0, e1));
+            hit = true;
+        }
+    }
+
+    t = best;
+    return hit;
+}
+
+SceneQuery::SceneQuery(WorkerPool *pool) :
+    pool(pool), lastBatchTime(0), lastBatchSize(0)
+{
+}
+
+void SceneQuery::build(const vector<shared_ptr<PhysicsObject>> &objects)
+{
+    vector<MeshData> old;
+    old.swap(meshes);
+    unordered_map<PhysicsObject *, size_t> oldIndex;
+    for (size_t i = 0; i < old.size(); i++)
+    {
+        oldIndex[old[i].owner] = i;
+    }
+
+    bodies.clear();
+    vector<vec3> mins;
+    vector<vec3> maxs;
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        PhysicsObject *obj = objects[i].get();
+        shared_ptr<Collider> col = obj->getCollider();
+        if (col == nullptr)
+        {
+            continue;
+        }
+
+        Body body;
+        body.object = (int)i;
+        body.mesh = -1;
+        ColliderMesh *meshCol = dynamic_cast<ColliderMesh *>(col.get());
+        body.isMesh = meshCol != nullptr;
+
+        if (body.isMesh)
+        {
+            mat4 M = translate(mat4(1.f), obj->position) * mat4_cast(obj->orientation) * glm::scale(mat4(1.f), obj->scale);
+
+            auto it = oldIndex.find(obj);
+            if (it != oldIndex.end() && old[it->second].M == M)
+            {
+                // hasn't moved since the last build
+                meshes.push_back(std::move(old[it->second]));
+            }
+            else
+            {
+                MeshData data;
+                data.owner = obj;
+                data.M = M;
+                const vector<float> &pos = meshCol->mesh->getPositions();
+                const vector<unsigned int> &ele = meshCol->mesh->getIndices();
+                data.tris.resize(ele.size());
+                for (size_t k = 0; k < ele.size(); k++)
+                {
+                    unsigned int v = ele[k];
+                    data.tris[k] = vec3(M * vec4(pos[v * 3], pos[v * 3 + 1], pos[v * 3 + 2], 1.0f));
+                }
+                vector<vec3> tmin(ele.size() / 3);
+                vector<vec3> tmax(ele.size() / 3);
+                for (size_t k = 0; k < tmin.size(); k++)
+                {
+                    tmin[k] = glm::min(data.tris[k * 3], glm::min(data.tris[k * 3 + 1], data.tris[k * 3 + 2]));
+                    tmax[k] = glm::max(data.tris[k * 3], glm::max(data.tris[k * 3 + 1], data.tris[k * 3 + 2]));
+                }
+                data.tree.build(tmin, tmax);
+                meshes.push_back(std::move(data));
+            }
+            body.mesh = (int)meshes.size() - 1;
+            const BoundsTree &meshTree = meshes.back().tree;
+            if (meshTree.empty())
+            {
+                meshes.pop_back();
+                continue;
+            }
+            body.min = meshTree.nodes[0].min;
+            body.max = meshTree.nodes[0].max;
+            body.center = (body.min + body.max) * 0.5f;
+            body.radius = length(body.max - body.min) * 0.5f;
+        }
+        else
+        {
+            body.center = obj->getCenterPos();
+            body.radius = obj->getRadius();
+            body.min = body.center - vec3(body.radius);
+            body.max = body.center + vec3(body.radius);
+        }
+
+        bodies.push_back(body);
+        mins.push_back(body.min);
+        maxs.push_back(body.max);
+    }
+
+    tree.build(mins, maxs, 2);
+}
+
+bool SceneQuery::sphereOverlap(const Body &body, const vec3 &c, float r) const
+{
+    if (!body.isMesh)
+    {
+        vec3 d = body.center - c;
+        return dot(d, d) <= (body.radius + r) * (body.radius + r);
+    }
+
+    const MeshData &mesh = meshes[body.mesh];
+    vector<int> candidates;
+    mesh.tree.queryBox(c - vec3(r), c + vec3(r), candidates);
+    for (int tri : candidates)
+    {
+        vec3 q = closestPointOnTriangle(c, mesh.tris[tri * 3], mesh.tris[tri * 3 + 1], mesh.tris[tri * 3 + 2]);
+        if (dot(q - c, q - c) <= r * r)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SceneQuery::boxOverlap(const Body &body, const vec3 &bmin, const vec3 &bmax) const
+{
+    if (!body.isMesh)
+    {
+        return BoundsTree::distance2(body.center, bmin, bmax) <= body.radius * body.radius;
+    }
+
+    const MeshData &mesh = meshes[body.mesh];
+    vec3 center = (bmin + bmax) * 0.5f;
+    vec3 half = (bmax - bmin) * 0.5f;
+    vector<int> candidates;
+    mesh.tree.queryBox(bmin, bmax, candidates);
+    for (int tri : candidates)
+    {
+        if (triangleBoxOverlap(center, half, mesh.tris[tri * 3], mesh.tris[tri * 3 + 1], mesh.tris[tri * 3 + 2]))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SceneQuery::sweep(const Body &body, const SphereSweepQuery &q, float &t, vec3 &normal) const
+{
+    if (!body.isMesh)
+    {
+        if (!raySphere(q.origin, q.direction, body.center, body.radius + q.radius, t) || t > q.maxDistance)
+        {
+            return false;
+        }
+        vec3 n = q.origin + q.direction * t - body.center;
+        normal = dot(n, n) > 0 ? normalize(n) : -q.direction;
+        return true;
+    }
+
+    const MeshData &mesh = meshes[body.mesh];
+    vec3 invDir = 1.0f / q.direction;
+    vec3 inflate = vec3(q.radius);
+    bool hit = false;
+    float best = q.maxDistance;
+
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const BoundsNode &node = mesh.tree.nodes[stack[--top]];
+        float tEnter;
+        if (!BoundsTree::intersectRay(q.origin, invDir, node.min - inflate, node.max + inflate, best, tEnter))
+        {
+            continue;
+        }
+        if (node.count == 0)
+        {
+            stack[top++] = node.first;
+            stack[top++] = node.first + 1;
+            continue;
+        }
+        for (int i = 0; i < node.count; i++)
+        {
+            int tri = mesh.tree.items[node.first + i];
+            float tt;
+            vec3 n;
+            if (sweepTriangle(q.origin, q.direction, q.radius, best,
+                mesh.tris[tri * 3], mesh.tris[tri * 3 + 1], mesh.tris[tri * 3 + 2], tt, n))
+            {
+                best = tt;
+                normal = n;
+                hit = true;
+            }
+        }
+    }
+    t = best;
+    return hit;
+}
+
+bool SceneQuery::closest(const Body &body, const vec3 &p, float maxDist2, vec3 &point, float &dist2) const
+{
+    if (!body.isMesh)
+    {
+        vec3 d = p - body.center;
+        float len = length(d);
+        point = len <= body.radius ? p : body.center + d * (body.radius / len);
+        dist2 = dot(point - p, point - p);
+        return dist2 <= maxDist2;
+    }
+
+    const MeshData &mesh = meshes[body.mesh];
+    bool found = false;
+    float best = maxDist2;
+
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const BoundsNode &node = mesh.tree.nodes[stack[--top]];
+        if (BoundsTree::distance2(p, node.min, node.max) > best)
+        {
+            continue;
+        }
+        if (node.count == 0)
+        {
+            stack[top++] = node.first;
+            stack[top++] = node.first + 1;
+            continue;
+        }
+        for (int i = 0; i < node.count; i++)
+        {
+            int tri = mesh.tree.items[node.first + i];
+            vec3 q = closestPointOnTriangle(p, mesh.tris[tri * 3], mesh.tris[tri * 3 + 1], mesh.tris[tri * 3 + 2]);
+            float d2 = dot(q - p, q - p);
+            if (d2 <= best)
+            {
+                best = d2;
+                point = q;
+                found = true;
+            }
+        }
+    }
+    dist2 = best;
+    return found;
+}
+
+template <typename Query, typename Test>
+void SceneQuery::overlap(const vector<Query> &queries, OverlapResults &results, Test test)
+{
+    int n = (int)queries.size();
+    results.counts.assign(n, 0);
+    results.offsets.assign(n, 0);
+    results.objects.clear();
+
+    // each chunk collects its own hits, chunks are concatenated in query order afterwards
+    vector<vector<int>> chunkHits((n + QUERY_GRAIN - 1) / QUERY_GRAIN);
+    pool->parallelFor(n, QUERY_GRAIN, [&](int begin, int end)
+    {
+        vector<int> &hits = chunkHits[begin / QUERY_GRAIN];
+        vector<int> candidates;
+        for (int i = begin; i < end; i++)
+        {
+            vec3 qmin, qmax;
+            test.bounds(queries[i], qmin, qmax);
+            candidates.clear();
+            tree.queryBox(qmin, qmax, candidates);
+            for (int b : candidates)
+            {
+                if (test.overlaps(bodies[b], queries[i]))
+                {
+                    hits.push_back(bodies[b].object);
+                    results.counts[i]++;
+                }
+            }
+        }
+    });
+
+    int offset = 0;
+    for (int i = 0; i < n; i++)
+    {
+        results.offsets[i] = offset;
+        offset += results.counts[i];
+    }
+    results.objects.reserve(offset);
+    for (size_t c = 0; c < chunkHits.size(); c++)
+    {
+        results.objects.insert(results.objects.end(), chunkHits[c].begin(), chunkHits[c].end());
+    }
+}
+
+void SceneQuery::overlapSpheres(const vector<SphereOverlapQuery> &queries, OverlapResults &results)
+{
+    auto start = chrono::high_resolution_clock::now();
+
+    struct Test
+    {
+        const SceneQuery *scene;
+        void bounds(const SphereOverlapQuery &q, vec3 &qmin, vec3 &qmax) const
+        {
+            qmin = q.center - vec3(q.radius);
+            qmax = q.center + vec3(q.radius);
+        }
+        bool overlaps(const Body &body, const SphereOverlapQuery &q) const
+        {
+            return scene->sphereOverlap(body, q.center, q.radius);
+        }
+    };
+    Test test = {this};
+    overlap(queries, results, test);
+
+    lastBatchSize = (int)queries.size();
+    lastBatchTime = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - start).count() * 0.001f;
+}
+
+void SceneQuery::overlapBoxes(const vector<BoxOverlapQuery> &queries, OverlapResults &results)
+{
+    auto start = chrono::high_resolution_clock::now();
+
+    struct Test
+    {
+        const SceneQuery *scene;
+        void bounds(const BoxOverlapQuery &q, vec3 &qmin, vec3 &qmax) const
+        {
+            qmin = q.min;
+            qmax = q.max;
+        }
+        bool overlaps(const Body &body, const BoxOverlapQuery &q) const
+        {
+            return scene->boxOverlap(body, q.min, q.max);
+        }
+    };
+    Test test = {this};
+    overlap(queries, results, test);
+
+    lastBatchSize = (int)queries.size();
+    lastBatchTime = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - start).count() * 0.001f;
+}
+
+void SceneQuery::sweepSpheres(const vector<SphereSweepQuery> &queries, SweepResults &results)
+{
+    auto start = chrono::high_resolution_clock::now();
+
+    int n = (int)queries.size();
+    results.objects.assign(n, -1);
+    results.distances.assign(n, 0);
+    results.positions.assign(n, vec3(0));
+    results.normals.assign(n, vec3(0));
+
+    pool->parallelFor(n, QUERY_GRAIN, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            const SphereSweepQuery &q = queries[i];
+            if (tree.empty())
+            {
+                continue;
+            }
+            vec3 invDir = 1.0f / q.direction;
+            vec3 inflate = vec3(q.radius);
+            float best = q.maxDistance;
+
+            int stack[64];
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0)
+            {
+                const BoundsNode &node = tree.nodes[stack[--top]];
+                float tEnter;
+                if (!BoundsTree::intersectRay(q.origin, invDir, node.min - inflate, node.max + inflate, best, tEnter))
+                {
+                    continue;
+                }
+                if (node.count == 0)
+                {
+                    stack[top++] = node.first;
+                    stack[top++] = node.first + 1;
+                    continue;
+                }
+                for (int k = 0; k < node.count; k++)
+                {
+                    const Body &body = bodies[tree.items[node.first + k]];
+                    SphereSweepQuery clipped = q;
+                    clipped.maxDistance = best;
+                    float t;
+                    vec3 normal;
+                    if (sweep(body, clipped, t, normal) && (results.objects[i] < 0 || t < best))
+                    {
+                        best = t;
+                        results.objects[i] = body.object;
+                        results.distances[i] = t;
+                        results.positions[i] = q.origin + q.direction * t;
+                        results.normals[i] = normal;
+                    }
+                }
+            }
+        }
+    });
+
+    lastBatchSize = n;
+    lastBatchTime = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - start).count() * 0.001f;
+}
+
+void SceneQuery::closestPoints(const vector<ClosestPointQuery> &queries, ClosestPointResults &results)
+{
+    auto start = chrono::high_resolution_clock::now();
+
+    int n = (int)queries.size();
+    results.objects.assign(n, -1);
+    results.points.assign(n, vec3(0));
+    results.distances.assign(n, 0);
+
+    pool->parallelFor(n, QUERY_GRAIN, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            const ClosestPointQuery &q = queries[i];
+            if (tree.empty())
+            {
+                continue;
+            }
+            float best = q.maxDistance * q.maxDistance;
+
+            int stack[64];
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0)
+            {
+                const BoundsNode &node = tree.nodes[stack[--top]];
+                if (BoundsTree::distance2(q.point, node.min, node.max) > best)
+                {
+                    continue;
+                }
+                if (node.count == 0)
+                {
+                    stack[top++] = node.first;
+                    stack[top++] = node.first + 1;
+                    continue;
+                }
+                for (int k = 0; k < node.count; k++)
+                {
+                    const Body &body = bodies[tree.items[node.first + k]];
+                    vec3 point;
+                    float d2;
+                    if (closest(body, q.point, best, point, d2))
+                    {
+                        best = d2;
+                        results.objects[i] = body.object;
+                        results.points[i] = point;
+                        results.distances[i] = sqrt(d2);
+                    }
+                }
+            }
+        }
+    });
+
+    lastBatchSize = n;
+    lastBatchTime = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - start).count() * 0.001f;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <glm/glm.hpp>
+
+#include "PhysicsObject.h"
+#include "../BoundsTree.h"
+#include "../WorkerPool.h"
+
+using namespace std;
+using namespace glm;
+
+// Batched spatial queries against the physics world.
+//
+// build() puts every object with a collider into a BoundsTree (and keeps a
+// world-space triangle tree per mesh collider, rebuilt only when the object
+// moves). Each query function takes an array of queries, runs the batch on
+// the worker pool and writes flat result arrays indexed by query. Object
+// indices in the results refer to the vector passed to build().
+
+struct SphereOverlapQuery
+{
+    vec3 center;
+    float radius;
+};
+
+struct BoxOverlapQuery
+{
+    vec3 min;
+    vec3 max;
+};
+
+struct SphereSweepQuery
+{
+    vec3 origin;
+    vec3 direction; // normalized
+    float radius;
+    float maxDistance;
+};
+
+struct ClosestPointQuery
+{
+    vec3 point;
+    float maxDistance;
+};
+
+// objects overlapping query i are objects[offsets[i] .. offsets[i] + counts[i])
+struct OverlapResults
+{
+    vector<int> offsets;
+    vector<int> counts;
+    vector<int> objects;
+};
+
+// objects[i] is -1 when the sweep hit nothing
+struct SweepResults
+{
+    vector<int> objects;
+    vector<float> distances; // distance travelled before contact
+    vector<vec3> positions; // sphere center at contact
+    vector<vec3> normals; // contact normal, pointing back at the sphere
+};
+
+// objects[i] is -1 when nothing is within maxDistance
+struct ClosestPointResults
+{
+    vector<int> objects;
+    vector<vec3> points;
+    vector<float> distances;
+};
+
+class SceneQuery
+{
+public:
+    SceneQuery(WorkerPool *pool = &WorkerPool::shared());
+
+    // Call after the objects moved (e.g. once per physics step)
+    void build(const vector<shared_ptr<PhysicsObject>> &objects);
+
+    void overlapSpheres(const vector<SphereOverlapQuery> &queries, OverlapResults &results);
+    void overlapBoxes(const vector<BoxOverlapQuery> &queries, OverlapResults &results);
+    void sweepSpheres(const vector<SphereSweepQuery> &queries, SweepResults &results);
+    void closestPoints(const vector<ClosestPointQuery> &queries, ClosestPointResults &results);
+
+    // wall time of the last batch, for profiling per query cost
+    float getLastBatchTime() const { return lastBatchTime; } // milliseconds
+    int getLastBatchSize() const { return lastBatchSize; }
+
+private:
+    struct Body
+    {
+        int object; // index into the objects passed to build()
+        bool isMesh;
+        vec3 center; // sphere colliders
+        float radius;
+        vec3 min; // world bounds
+        vec3 max;
+        int mesh; // index into meshes, -1 for spheres
+    };
+
+    struct MeshData
+    {
+        PhysicsObject *owner;
+        mat4 M;
+        vector<vec3> tris; // world space, 3 per triangle
+        BoundsTree tree;
+    };
+
+    bool sphereOverlap(const Body &body, const vec3 &c, float r) const;
+    bool boxOverlap(const Body &body, const vec3 &bmin, const vec3 &bmax) const;
+    bool sweep(const Body &body, const SphereSweepQuery &q, float &t, vec3 &normal) const;
+    bool closest(const Body &body, const vec3 &p, float maxDist2, vec3 &point, float &dist2) const;
+
+    template <typename Query, typename Test>
+    void overlap(const vector<Query> &queries, OverlapResults &results, Test test);
+
+    WorkerPool *pool;
+    BoundsTree tree;
+    vector<Body> bodies;
+    vector<MeshData> meshes;
+    float lastBatchTime;
+    int lastBatchSize;
+};